@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include "devices/ide.h"
 #include "threads/malloc.h"
+#include "threads/trace.h"
 
 /* A block device. */
 struct block
@@ -121,7 +122,9 @@ void
 block_read (struct block *block, block_sector_t sector, void *buffer)
 {
   check_sector (block, sector);
+  trace_log (TRACE_BLOCK_SUBMIT, sector);
   block->ops->read (block->aux, sector, buffer);
+  trace_log (TRACE_BLOCK_COMPLETE, sector);
   block->read_cnt++;
 }
 
@@ -135,10 +138,70 @@ block_write (struct block *block, block_sector_t sector, const void *buffer)
 {
   check_sector (block, sector);
   ASSERT (block->type != BLOCK_FOREIGN);
+  trace_log (TRACE_BLOCK_SUBMIT, sector | TRACE_BLOCK_WRITE);
   block->ops->write (block->aux, sector, buffer);
+  trace_log (TRACE_BLOCK_COMPLETE, sector | TRACE_BLOCK_WRITE);
   block->write_cnt++;
 }
 
+/* Reads the CNT sectors starting at SECTOR from BLOCK into
+   BUFFER, which must have room for CNT * BLOCK_SECTOR_SIZE
+   bytes.  Drivers that support it transfer all of them with a
+   single request, which is much faster than one request per
+   sector.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_read_multiple (struct block *block, block_sector_t sector,
+                     block_sector_t cnt, void *buffer_)
+{
+  uint8_t *buffer = buffer_;
+  block_sector_t i;
+
+  if (cnt == 0)
+    return;
+  check_sector (block, sector);
+  check_sector (block, sector + cnt - 1);
+  trace_log (TRACE_BLOCK_SUBMIT, sector);
+  if (block->ops->read_multiple != NULL)
+    block->ops->read_multiple (block->aux, sector, cnt, buffer);
+  else
+    for (i = 0; i < cnt; i++)
+      block->ops->read (block->aux, sector + i,
+                        buffer + i * BLOCK_SECTOR_SIZE);
+  trace_log (TRACE_BLOCK_COMPLETE, sector);
+  block->read_cnt += cnt;
+}
+
+/* Writes the CNT sectors starting at SECTOR to BLOCK from
+   BUFFER, which must contain CNT * BLOCK_SECTOR_SIZE bytes, as
+   for block_read_multiple().  Returns after the block device has
+   acknowledged receiving all of the data.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_write_multiple (struct block *block, block_sector_t sector,
+                      block_sector_t cnt, const void *buffer_)
+{
+  const uint8_t *buffer = buffer_;
+  block_sector_t i;
+
+  if (cnt == 0)
+    return;
+  check_sector (block, sector);
+  check_sector (block, sector + cnt - 1);
+  ASSERT (block->type != BLOCK_FOREIGN);
+  trace_log (TRACE_BLOCK_SUBMIT, sector | TRACE_BLOCK_WRITE);
+  if (block->ops->write_multiple != NULL)
+    block->ops->write_multiple (block->aux, sector, cnt, buffer);
+  else
+    for (i = 0; i < cnt; i++)
+      block->ops->write (block->aux, sector + i,
+                         buffer + i * BLOCK_SECTOR_SIZE);
+  trace_log (TRACE_BLOCK_COMPLETE, sector | TRACE_BLOCK_WRITE);
+  block->write_cnt += cnt;
+}
+
 /* Returns the number of sectors in BLOCK. */
 block_sector_t
 block_size (struct block *block)
@@ -11,9 +11,6 @@
 #define PIT_PORT_CONTROL          0x43                /* Control port. */
 #define PIT_PORT_COUNTER(CHANNEL) (0x40 + (CHANNEL))  /* Counter port. */
 
-/* PIT cycles per second. */
-#define PIT_HZ 1193180
-
 /* Configure the given CHANNEL in the PIT.  In a PC, the PIT's
    three output channels are hooked up like this:
 
@@ -81,3 +78,49 @@ pit_configure_channel (int channel, int mode, int frequency)
   outb (PIT_PORT_COUNTER (channel), count >> 8);
   intr_set_level (old_level);
 }
+
+/* Starts a single countdown of COUNT PIT cycles on CHANNEL, in
+   mode 0 ("interrupt on terminal count"): the channel's output
+   goes low now and rises, once, when the count runs out.  On
+   channel 0 this raises a single timer interrupt.  A COUNT of 0
+   is treated as 65536. */
+void
+pit_start_oneshot (int channel, uint16_t count)
+{
+  enum intr_level old_level;
+
+  ASSERT (channel == 0 || channel == 2);
+
+  old_level = intr_disable ();
+  outb (PIT_PORT_CONTROL, (channel << 6) | 0x30);
+  outb (PIT_PORT_COUNTER (channel), count);
+  outb (PIT_PORT_COUNTER (channel), count >> 8);
+  intr_set_level (old_level);
+}
+
+/* Returns the number of PIT cycles left in CHANNEL's current
+   count.  If OUT is nonnull, stores the state of the channel's
+   output in *OUT; in mode 0 it is true once the count has run
+   out.
+
+   Uses the 8254 "read-back" command, which latches the status
+   and the count together. */
+uint16_t
+pit_read_count (int channel, bool *out)
+{
+  enum intr_level old_level;
+  uint8_t status, lo, hi;
+
+  ASSERT (channel == 0 || channel == 2);
+
+  old_level = intr_disable ();
+  outb (PIT_PORT_CONTROL, 0xc0 | (2 << channel));
+  status = inb (PIT_PORT_COUNTER (channel));
+  lo = inb (PIT_PORT_COUNTER (channel));
+  hi = inb (PIT_PORT_COUNTER (channel));
+  intr_set_level (old_level);
+
+  if (out != NULL)
+    *out = (status & 0x80) != 0;
+  return (hi << 8) | lo;
+}
@@ -5,7 +5,10 @@
 #include "devices/serial.h"
 #include "devices/timer.h"
 #include "threads/io.h"
+#include "threads/memstat.h"
+#include "threads/slab.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
 #ifdef USERPROG
 #include "userprog/exception.h"
 #endif
@@ -13,6 +16,10 @@
 #include "devices/block.h"
 #include "filesys/filesys.h"
 #endif
+#ifdef VM
+#include "vm/swap.h"
+#include "vm/vpage.h"
+#endif
 
 /* Keyboard control register port. */
 #define CONTROL_REG 0x64
@@ -93,6 +100,7 @@ shutdown_power_off (void)
 #ifdef FILESYS
   filesys_done ();
 #endif
+  trace_dump ();
 
   print_stats ();
 
@@ -130,8 +138,14 @@ print_stats (void)
 {
   timer_print_stats ();
   thread_print_stats ();
+  kmem_cache_print_stats ();
+  memstat_print ();
 #ifdef FILESYS
   block_print_stats ();
+#endif
+#ifdef VM
+  swap_print_stats ();
+  vpage_print_stats ();
 #endif
   console_print_stats ();
   kbd_print_stats ();
@@ -7,6 +7,7 @@
 #include "threads/interrupt.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/tsc.h"
 #include "userprog/process.h"
   
 /* See [8254] for hardware details of the 8254 timer chip. */
@@ -21,21 +22,67 @@
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* CPU cycles spent in the timer interrupt handler since OS
+   booted. */
+static uint64_t interrupt_cycles;
+
+/* If true, the periodic tick is stopped while the CPU is idle.
+   Set by the kernel command-line option "-tickless". */
+bool timer_tickless;
+
+/* PIT cycles per timer tick. */
+#define TIMER_PIT_COUNT ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Number of ticks that the pending one-shot PIT count stands
+   for, or 0 if the PIT is in periodic mode. */
+static int oneshot_ticks;
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/* Timing wheel of pending timer events.
+
+   Level 0 has one slot per tick for the next TIMER_WHEEL_SIZE
+   ticks; each slot of level N covers TIMER_WHEEL_SIZE times as
+   many ticks as a slot of level N - 1.  When the level 0 index
+   wraps around, the current slot of level 1 is "cascaded", that
+   is, its events are redistributed into lower levels, and so on
+   upward.  Events too far in the future for the top level wait
+   on timer_wheel_overflow until the top level wraps. */
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SIZE (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SIZE - 1)
+#define TIMER_WHEEL_LEVELS 4
+static struct list timer_wheel[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SIZE];
+static struct list timer_wheel_overflow;
+
+/* Next tick whose level 0 slot has not been run yet. */
+static int64_t timer_wheel_clock;
+
 static intr_handler_func timer_interrupt;
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
 static void real_time_delay (int64_t num, int32_t denom);
+static void timer_wheel_insert (struct timer_event *);
+static void timer_wheel_cascade (struct list *);
+static void timer_wheel_advance (int64_t now);
+static int timer_wheel_quiet_ticks (int limit);
+static void timer_tick (void);
 
 /* Sets up the timer to interrupt TIMER_FREQ times per second,
    and registers the corresponding interrupt. */
 void
 timer_init (void) 
 {
+  int level, slot;
+
+  for (level = 0; level < TIMER_WHEEL_LEVELS; level++)
+    for (slot = 0; slot < TIMER_WHEEL_SIZE; slot++)
+      list_init (&timer_wheel[level][slot]);
+  list_init (&timer_wheel_overflow);
+
   pit_configure_channel (0, 2, TIMER_FREQ);
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
@@ -157,6 +204,17 @@ timer_ndelay (int64_t ns)
   real_time_delay (ns, 1000 * 1000 * 1000);
 }
 
+/* Returns the number of CPU cycles spent handling timer
+   interrupts since the OS booted. */
+uint64_t
+timer_interrupt_cycles (void) 
+{
+  enum intr_level old_level = intr_disable ();
+  uint64_t c = interrupt_cycles;
+  intr_set_level (old_level);
+  return c;
+}
+
 /* Prints timer statistics. */
 void
 timer_print_stats (void) 
@@ -164,12 +222,264 @@ timer_print_stats (void)
   printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
 }
 
+/* Initializes timer event E to call FUNC(AUX) when it expires.
+   The event is not armed. */
+void
+timer_event_init (struct timer_event *e, timer_event_func *func, void *aux)
+{
+  ASSERT (e != NULL);
+  ASSERT (func != NULL);
+
+  e->func = func;
+  e->aux = aux;
+  e->expires = 0;
+  e->armed = false;
+}
+
+/* Arms E to fire at tick EXPIRES, rearming it if it is already
+   pending.  An EXPIRES in the past fires at the next tick.
+
+   This function may be called from an interrupt handler,
+   including from another event's callback. */
+void
+timer_event_arm (struct timer_event *e, int64_t expires)
+{
+  enum intr_level old_level;
+
+  ASSERT (e != NULL);
+
+  old_level = intr_disable ();
+  if (e->armed)
+    list_remove (&e->elem);
+  e->expires = expires;
+  e->armed = true;
+  timer_wheel_insert (e);
+  intr_set_level (old_level);
+}
+
+/* Disarms E.  Returns true if E was pending, false if it had
+   already fired or was never armed. */
+bool
+timer_event_cancel (struct timer_event *e)
+{
+  enum intr_level old_level;
+  bool was_armed;
+
+  ASSERT (e != NULL);
+
+  old_level = intr_disable ();
+  was_armed = e->armed;
+  if (was_armed)
+    {
+      list_remove (&e->elem);
+      e->armed = false;
+    }
+  intr_set_level (old_level);
+  return was_armed;
+}
+
+/* Called by the idle thread, with interrupts off, just before
+   it halts the CPU.  In tickless mode, if no timer event is due
+   in the next few ticks, replaces the periodic tick by a single
+   interrupt at the first tick that has work to do.  The PIT can
+   count at most 65536 cycles, so at the default TIMER_FREQ at
+   most 5 timer interrupts in a row are skipped. */
+void
+timer_idle_enter (void) 
+{
+  uint16_t remaining;
+  int max_ticks, quiet;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!timer_tickless || oneshot_ticks != 0)
+    return;
+
+  /* Keep the tick boundaries where the periodic tick would have
+     put them: the first skipped tick ends when the current
+     period does. */
+  remaining = pit_read_count (0, NULL);
+  if (remaining < 2 || remaining > TIMER_PIT_COUNT)
+    return;
+  max_ticks = (UINT16_MAX - remaining) / TIMER_PIT_COUNT;
+  quiet = timer_wheel_quiet_ticks (max_ticks);
+  if (quiet == 0)
+    return;
+
+  oneshot_ticks = quiet + 1;
+  pit_start_oneshot (0, remaining + quiet * TIMER_PIT_COUNT);
+}
+
+/* Called on entry to every external interrupt handler.  If the
+   interrupt ended a tickless idle period early, accounts for the
+   ticks that have passed so that timer_ticks() is current by the
+   time the handler runs, and arranges for the periodic tick to
+   resume at the next tick boundary. */
+void
+timer_irq_enter (void) 
+{
+  uint16_t remaining;
+  int pending;
+  bool expired;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (oneshot_ticks == 0)
+    return;
+
+  /* If the count ran out, the timer interrupt is being handled
+     or is about to be, and timer_interrupt() will catch up. */
+  remaining = pit_read_count (0, &expired);
+  if (expired)
+    return;
+
+  pending = DIV_ROUND_UP (remaining, TIMER_PIT_COUNT);
+  while (oneshot_ticks > pending) 
+    {
+      oneshot_ticks--;
+      timer_tick ();
+    }
+
+  /* Count down to the next tick boundary only. */
+  remaining -= (pending - 1) * TIMER_PIT_COUNT;
+  oneshot_ticks = 1;
+  pit_start_oneshot (0, remaining < 2 ? 2 : remaining);
+}
+
 /* Timer interrupt handler. */
 static void
 timer_interrupt (struct intr_frame *args UNUSED)
+{
+  uint64_t start = rdtsc ();
+
+  if (oneshot_ticks != 0) 
+    {
+      /* End of a tickless idle period: go back to periodic mode
+         and run the ticks that were skipped. */
+      int skipped = oneshot_ticks;
+      oneshot_ticks = 0;
+      pit_configure_channel (0, 2, TIMER_FREQ);
+      while (skipped-- > 0)
+        timer_tick ();
+    }
+  else
+    timer_tick ();
+
+  interrupt_cycles += rdtsc () - start;
+}
+
+/* Advances the tick count by one and does the work due at that
+   tick. */
+static void
+timer_tick (void) 
 {
   ticks++;
-  thread_tick();
+  timer_wheel_advance (ticks);
+  thread_tick ();
+}
+
+/* Puts E into the wheel slot that covers E->expires.
+   Interrupts must be off. */
+static void
+timer_wheel_insert (struct timer_event *e)
+{
+  int64_t expires = e->expires < timer_wheel_clock ? timer_wheel_clock : e->expires;
+  int64_t delta = expires - timer_wheel_clock;
+  int level;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (level = 0; level < TIMER_WHEEL_LEVELS; level++)
+    if (delta < (int64_t) 1 << (TIMER_WHEEL_BITS * (level + 1)))
+      {
+        int slot = (expires >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+        list_push_back (&timer_wheel[level][slot], &e->elem);
+        return;
+      }
+  list_push_back (&timer_wheel_overflow, &e->elem);
+}
+
+/* Redistributes the events in SLOT relative to the current
+   timer_wheel_clock.  Relative order of events is kept, so
+   events for the same tick fire in the order they were armed. */
+static void
+timer_wheel_cascade (struct list *slot)
+{
+  struct list pending;
+
+  list_init (&pending);
+  while (!list_empty (slot))
+    list_push_back (&pending, list_pop_front (slot));
+  while (!list_empty (&pending))
+    timer_wheel_insert (list_entry (list_pop_front (&pending),
+                                    struct timer_event, elem));
+}
+
+/* Fires every event that expires at or before tick NOW.
+
+   The due slot is detached and the clock moved past it before
+   any callback runs, so an event that a callback re-arms for the
+   current tick or earlier goes to the next tick instead of
+   firing again in the same pass. */
+static void
+timer_wheel_advance (int64_t now)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (timer_wheel_clock <= now)
+    {
+      int level;
+      int slot = timer_wheel_clock & TIMER_WHEEL_MASK;
+      struct list *due;
+      struct list expired;
+
+      /* Each time a level wraps around, pull the next slot of the
+         level above it down. */
+      for (level = 1; slot == 0 && level <= TIMER_WHEEL_LEVELS; level++)
+        {
+          if (level == TIMER_WHEEL_LEVELS)
+            {
+              timer_wheel_cascade (&timer_wheel_overflow);
+              break;
+            }
+          slot = (timer_wheel_clock >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+          timer_wheel_cascade (&timer_wheel[level][slot]);
+        }
+
+      due = &timer_wheel[0][timer_wheel_clock & TIMER_WHEEL_MASK];
+      list_init (&expired);
+      while (!list_empty (due))
+        list_push_back (&expired, list_pop_front (due));
+      timer_wheel_clock++;
+
+      while (!list_empty (&expired))
+        {
+          struct timer_event *e = list_entry (list_pop_front (&expired),
+                                              struct timer_event, elem);
+          e->armed = false;
+          e->func (e->aux);
+        }
+    }
+}
+
+/* Returns the number of upcoming ticks, up to LIMIT, at which
+   there is nothing to do: no event expires and no wheel level
+   wraps around (a wrap may cascade events due soon after). */
+static int
+timer_wheel_quiet_ticks (int limit)
+{
+  int n;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (n = 0; n < limit; n++)
+    {
+      int64_t t = timer_wheel_clock + n;
+      if ((t & TIMER_WHEEL_MASK) == 0
+          || !list_empty (&timer_wheel[0][t & TIMER_WHEEL_MASK]))
+        break;
+    }
+  return n;
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
@@ -1,7 +1,9 @@
 #ifndef DEVICES_TIMER_H
 #define DEVICES_TIMER_H
 
+#include <list.h>
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
@@ -12,6 +14,7 @@ void timer_calibrate (void);
 
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
+uint64_t timer_interrupt_cycles (void);
 
 /* Sleep and yield the CPU to other threads. */
 void timer_sleep (int64_t ticks);
@@ -26,4 +29,32 @@ void timer_ndelay (int64_t nanoseconds);
 
 void timer_print_stats (void);
 
+/* Tickless idle. */
+extern bool timer_tickless;
+void timer_idle_enter (void);
+void timer_irq_enter (void);
+
+/* Kernel timers.
+
+   A timer event calls FUNC(AUX) from the timer interrupt
+   handler, with interrupts off, at the first timer tick at or
+   after the tick it was armed for.  Pending events are kept on a
+   hierarchical timing wheel, so arming and cancelling take
+   constant time and expiry is amortized constant time per
+   tick. */
+typedef void timer_event_func (void *aux);
+
+struct timer_event
+  {
+    struct list_elem elem;      /* Element in a timer wheel slot. */
+    int64_t expires;            /* Tick to fire at. */
+    timer_event_func *func;     /* Called on expiry. */
+    void *aux;                  /* Argument to FUNC. */
+    bool armed;                 /* On the wheel, not yet fired? */
+  };
+
+void timer_event_init (struct timer_event *, timer_event_func *, void *aux);
+void timer_event_arm (struct timer_event *, int64_t expires);
+bool timer_event_cancel (struct timer_event *);
+
 #endif /* devices/timer.h */
@@ -9,41 +9,87 @@
 #include "threads/malloc.h"
 #include "threads/thread.h"
 #include "threads/synch.h"
+#include "threads/trace.h"
+#include "threads/workqueue.h"
 
 #define BCACHE_MAX_ENTRIES 0x40
+// number of read-ahead requests that can be queued or running at once
+#define BCACHE_READ_AHEAD_MAX 8
+// dirty entries are written back this often, as well as on eviction
+#define BCACHE_FLUSH_INTERVAL (30 * TIMER_FREQ)
 
 struct bcache_entry {
 	struct lock lock;
 	bool in_use;
+	bool dirty;
 	int64_t last_use;
 	block_sector_t sector;
 	uint8_t data[BLOCK_SECTOR_SIZE];
 };
 
+// one read-ahead request. it stays busy from being queued until its worker is done with it,
+// so its sector cannot be overwritten by another miss in the meantime
+struct read_ahead {
+	struct work work;
+	block_sector_t sector;
+	bool busy;
+};
+
 static struct bcache_entry *bcache;
-// conditional variables
-bool read_ahead_work_given;
-block_sector_t read_ahead_work;
-static struct lock read_ahead_lock;
-static struct condition read_ahead_condvar;
+// read-ahead and periodic writeback run on system_wq
+static struct read_ahead read_ahead[BCACHE_READ_AHEAD_MAX];
+static struct lock read_ahead_lock;	// protects the busy flags and sectors of read_ahead
+static struct delayed_work flush_work;
 static uint8_t dummy[BLOCK_SECTOR_SIZE];
 
 static void read_ahead_func(void *);
+static void read_ahead_queue(block_sector_t);
+static void flush_func(void *);
 static void bcache_read_internal(block_sector_t, void *, bool);
 static void bcache_entry_occupy(struct bcache_entry *, block_sector_t);
 
-static void read_ahead_func(void *aux) {
-	while(1) {
-		lock_acquire(&read_ahead_lock);
-		while (!read_ahead_work_given) {
-			cond_wait(&read_ahead_condvar, &read_ahead_lock);
+static void read_ahead_func(void *ra_) {
+	struct read_ahead *ra = ra_;
+	bcache_read_internal(ra->sector, dummy, false);
+	lock_acquire(&read_ahead_lock);
+	ra->busy = false;
+	lock_release(&read_ahead_lock);
+}
+
+// queues a read-ahead of sector, unless one is already in flight or all requests are busy
+static void read_ahead_queue(block_sector_t sector) {
+	struct read_ahead *free_ra = NULL;
+	lock_acquire(&read_ahead_lock);
+	for (int i = 0; i < BCACHE_READ_AHEAD_MAX; i++) {
+		struct read_ahead *ra = &read_ahead[i];
+		if (ra->busy && ra->sector == sector) {
+			free_ra = NULL;
+			break;
+		}
+		if (!ra->busy && free_ra == NULL) {
+			free_ra = ra;
 		}
-		bcache_read_internal(read_ahead_work, dummy, false);
-		read_ahead_work = 0;
-		read_ahead_work_given = false;
-		lock_release(&read_ahead_lock);
 	}
-	
+	if (free_ra != NULL) {
+		free_ra->busy = true;
+		free_ra->sector = sector;
+		queue_work(&system_wq, &free_ra->work);
+	}
+	lock_release(&read_ahead_lock);
+}
+
+// writes back dirty entries, keeping them cached
+static void flush_func(void *aux UNUSED) {
+	for (int i = 0; i < BCACHE_MAX_ENTRIES; i++) {
+		struct bcache_entry *e = &bcache[i];
+		lock_acquire(&e->lock);
+		if (e->in_use && e->dirty) {
+			block_write(fs_device, e->sector, e->data);
+			e->dirty = false;
+		}
+		lock_release(&e->lock);
+	}
+	queue_delayed_work(&system_wq, &flush_work, BCACHE_FLUSH_INTERVAL);
 }
 
 static void bcache_read_internal(block_sector_t sector, void *out_, bool trigger_read_ahead) {
@@ -57,6 +103,7 @@ static void bcache_read_internal(block_sector_t sector, void *out_, bool trigger
 		cur = &bcache[i];
 		lock_acquire(&cur->lock);
 		if (cur->in_use && cur->sector == sector) {
+			trace_log(TRACE_BCACHE_HIT, sector);
 			cur->last_use = timer_ticks();
 			memcpy(out, &cur->data, sizeof(cur->data));
 			lock_release(&cur->lock);
@@ -71,6 +118,7 @@ static void bcache_read_internal(block_sector_t sector, void *out_, bool trigger
 		}
 		lock_release(&cur->lock);
 	}
+	trace_log(TRACE_BCACHE_MISS, sector);
 	{
 		// Evict the LRU entry
 		if (free_idx == -1) {
@@ -87,18 +135,15 @@ static void bcache_read_internal(block_sector_t sector, void *out_, bool trigger
 			memcpy(out, victim->data, sizeof(victim->data));
 			lock_release(&victim->lock);
 		}
-		if (trigger_read_ahead) {
-			lock_acquire(&read_ahead_lock);
-			read_ahead_work = sector + 1;
-			read_ahead_work_given = true;
-			cond_signal(&read_ahead_condvar, &read_ahead_lock);
-			lock_release(&read_ahead_lock);
+		if (trigger_read_ahead && sector + 1 < block_size(fs_device)) {
+			read_ahead_queue(sector + 1);
 		}
 	}
 }
 
 static void bcache_entry_init(struct bcache_entry *e) {
 	e->in_use = false;
+	e->dirty = false;
 	e->last_use = 0;
 	lock_init(&e->lock);
 }
@@ -106,9 +151,13 @@ static void bcache_entry_init(struct bcache_entry *e) {
 // synchronization must be guaranteed by the caller
 static void bcache_entry_occupy(struct bcache_entry *e, block_sector_t sector) {
 	if (e->in_use) {
-		block_write(fs_device, e->sector, e->data);
+		trace_log(TRACE_BCACHE_EVICT, e->sector);
+		if (e->dirty) {
+			block_write(fs_device, e->sector, e->data);
+		}
 	}
 	e->in_use = true;
+	e->dirty = false;
 	e->sector = sector;
 	e->last_use = timer_ticks();
 	block_read(fs_device, sector, e->data);
@@ -117,7 +166,10 @@ static void bcache_entry_occupy(struct bcache_entry *e, block_sector_t sector) {
 static void bcache_entry_release(struct bcache_entry *e) {
 	if (e->in_use) {
 		e->in_use = false;
-		block_write(fs_device, e->sector, e->data);
+		if (e->dirty) {
+			block_write(fs_device, e->sector, e->data);
+			e->dirty = false;
+		}
 	}
 }
 
@@ -129,11 +181,12 @@ void bcache_init () {
 		bcache_entry_init(&bcache[i]);
 	}
 	lock_init(&read_ahead_lock);
-	cond_init(&read_ahead_condvar);
-	read_ahead_work_given = false;
-	//if (thread_create("read-ahead", PRI_DEFAULT, read_ahead_func, NULL) == TID_ERROR) {
-	//	PANIC("bache_init: thread_create failed");
-	//}
+	for (int i = 0; i < BCACHE_READ_AHEAD_MAX; i++) {
+		read_ahead[i].busy = false;
+		work_init(&read_ahead[i].work, read_ahead_func, &read_ahead[i]);
+	}
+	delayed_work_init(&flush_work, flush_func, NULL);
+	queue_delayed_work(&system_wq, &flush_work, BCACHE_FLUSH_INTERVAL);
 }
 
 // bounce buffer must be provided by caller
@@ -148,8 +201,10 @@ void bcache_write_at(block_sector_t sector, void *in_, off_t offset, size_t leng
 		cur = &bcache[i];
 		lock_acquire(&cur->lock);
 		if (cur->in_use && cur->sector == sector) {
+			trace_log(TRACE_BCACHE_HIT, sector);
 			cur->last_use = timer_ticks();
 			memcpy(&cur->data[offset], in, length);
+			cur->dirty = true;
 			lock_release(&cur->lock);
 			return;
 		}
@@ -162,6 +217,7 @@ void bcache_write_at(block_sector_t sector, void *in_, off_t offset, size_t leng
 		}
 		lock_release(&cur->lock);
 	}
+	trace_log(TRACE_BCACHE_MISS, sector);
 	{
 		// Evict the LRU entry
 		if (free_idx == -1) {
@@ -169,6 +225,7 @@ void bcache_write_at(block_sector_t sector, void *in_, off_t offset, size_t leng
 			lock_acquire(&victim->lock);
 			bcache_entry_occupy(victim, sector);
 			memcpy(&victim->data[offset], in, length);
+			victim->dirty = true;
 			lock_release(&victim->lock);
 		}
 		else {
@@ -176,6 +233,7 @@ void bcache_write_at(block_sector_t sector, void *in_, off_t offset, size_t leng
 			lock_acquire(&victim->lock);
 			bcache_entry_occupy(victim, sector);
 			memcpy(&victim->data[offset], in, length);
+			victim->dirty = true;
 			lock_release(&victim->lock);
 		}
 	}
@@ -185,13 +243,20 @@ void bcache_write(block_sector_t sector, void *in_) {
 	bcache_write_at(sector, in_, 0, BLOCK_SECTOR_SIZE);
 }
 
+// a miss also queues a read-ahead of the next sector on system_wq
 void bcache_read(block_sector_t sector, void *out_) {
-	bcache_read_internal(sector, out_, false);
+	bcache_read_internal(sector, out_, true);
 }
 
 
-/* this function does not require internal synch because it is only called on timer interrupts and on filesys_done */
+/* 
+  this function does not require internal synch because it is only called on filesys_done,
+  once periodic writeback has been stopped
+*/
 void bcache_sync() {
+	cancel_delayed_work(&flush_work);
+	flush_workqueue(&system_wq);
+	cancel_delayed_work(&flush_work);
 	for (int i = 0; i < BCACHE_MAX_ENTRIES; i++) {
 		struct bcache_entry *e;
 		e = &bcache[i];
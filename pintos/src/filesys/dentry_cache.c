@@ -1,5 +1,7 @@
 #include "filesys/dentry_cache.h"
 #include "filesys/directory.h"
+#include "threads/malloc.h"
+#include "threads/slab.h"
 #include "threads/synch.h"
 #include <hash.h>
 #include <string.h>
@@ -9,6 +11,9 @@
 #define DENTRY_CACHE 1
 
 static struct hash dentry_cache;
+/* readers of dir_lock fill the cache too, so it needs a lock of its own */
+static struct rwlock dentry_cache_lock;
+static struct kmem_cache dentry_cache_entry_cache;
 
 struct dentry_cache_entry {
     struct hash_elem elem;
@@ -47,9 +52,10 @@ dentry_cache_entry_less(const struct hash_elem *e1_, const struct hash_elem *e2_
 
 void dentry_cache_init() {
     hash_init(&dentry_cache, dentry_cache_entry_hash_func, dentry_cache_entry_less, NULL);
+    rwlock_init(&dentry_cache_lock);
+    kmem_cache_init(&dentry_cache_entry_cache, "dentry", sizeof(struct dentry_cache_entry), 0, NULL);
 }
 
-// we don't need synchronization at the dentry cache layer, because synchronization is already implemented in the dir layer
 // dentry cache only stores absoulte paths
 bool dentry_cache_query(const struct canon_path *cpath, size_t outer_level, int *inumber) {
     bool success;
@@ -65,16 +71,17 @@ bool dentry_cache_query(const struct canon_path *cpath, size_t outer_level, int
     }
     dce.inumber = 0;
     dce.path = path;
+    rwlock_acquire_read(&dentry_cache_lock);
     if ((e = hash_find(&dentry_cache, &dce.elem))) {
         found = hash_entry(e, struct dentry_cache_entry, elem);
         *inumber = found->inumber;
         success = true;
-        goto done;
     }
     else {
         success = false;
-        goto done;
     }
+    rwlock_release_read(&dentry_cache_lock);
+    goto done;
 
 done:
     free(path);
@@ -88,6 +95,7 @@ bool dentry_cache_invalidate(int inumber) {
     struct hash_iterator i;
     success = false;
 #ifdef DENTRY_CACHE
+    rwlock_acquire_write(&dentry_cache_lock);
 do_again:
     hash_first(&i, &dentry_cache);
     while(hash_next(&i)) {
@@ -95,10 +103,12 @@ do_again:
         if (dce->inumber == inumber) {
             success = true;
             hash_delete(&dentry_cache, &dce->elem);
-            free(dce);
+            free(dce->path);
+            kmem_cache_free(&dentry_cache_entry_cache, dce);
             goto do_again;
         }
     }
+    rwlock_release_write(&dentry_cache_lock);
 done:
 #endif
     return success;
@@ -115,13 +125,17 @@ bool dentry_cache_append(const struct canon_path *cpath, size_t outer_level, int
     if (!canon_path_serialize(cpath, outer_level, &path, &path_length)) {
         return false;        
     }
-    if ((new = malloc(sizeof(*new))) == NULL) {
+    if ((new = kmem_cache_alloc(&dentry_cache_entry_cache)) == NULL) {
         goto done;
     }
     new->path = strdup(path);
     new->inumber = inumber;
-    if (e = (hash_insert(&dentry_cache, &new->elem))) {
-        free(new);
+    rwlock_acquire_write(&dentry_cache_lock);
+    e = hash_insert(&dentry_cache, &new->elem);
+    rwlock_release_write(&dentry_cache_lock);
+    if (e) {
+        free(new->path);
+        kmem_cache_free(&dentry_cache_entry_cache, new);
         success = true;
         goto done;
     }
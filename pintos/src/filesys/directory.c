@@ -9,7 +9,9 @@
 #include "threads/synch.h"
 #include "filesys/dentry_cache.h"
 
-static struct lock dir_lock;
+/* Protects directory contents.  Path resolution and lookups
+   only read, so they share it. */
+static struct rwlock dir_lock;
 
 /* A directory. */
 struct dir 
@@ -76,7 +78,7 @@ lookup (const struct dir *dir, const char *path,
 }
 
 void dir_init() {
-  lock_init(&dir_lock);
+  rwlock_init(&dir_lock);
   dentry_cache_init();
 }
 
@@ -127,7 +129,7 @@ struct dir *dir_open_canon_path(struct canon_path *cpath, bool is_dir) {
   int inumber;
   struct inode *inode;
   size_t num_iters;
-  lock_acquire(&dir_lock);
+  rwlock_acquire_read(&dir_lock);
   if (canon_path_is_absolute(cpath)) {
     // query the dentry cache
     if (is_dir) {
@@ -204,7 +206,7 @@ done:
   }
   
 done_dontcache:
-  lock_release(&dir_lock);
+  rwlock_release_read(&dir_lock);
   // at the point of return, current is open
   return current;
 }
@@ -248,12 +250,12 @@ dir_lookup (const struct dir *dir, const char *path,
   ASSERT (dir != NULL);
   ASSERT (path != NULL);
 
-  lock_acquire(&dir_lock);
+  rwlock_acquire_read(&dir_lock);
   if (lookup (dir, path, &e, NULL))
     *inode = inode_open (e.inode_sector);
   else
     *inode = NULL;
-  lock_release(&dir_lock);
+  rwlock_release_read(&dir_lock);
   return *inode != NULL;
 }
 
@@ -272,11 +274,12 @@ dir_add (struct dir *dir, const struct canon_path *cpath, const char *name, bloc
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
-  lock_acquire(&dir_lock);
   /* Check NAME for validity. */
   if (*name == '\0' || strlen (name) > NAME_MAX)
     return false;
 
+  rwlock_acquire_write(&dir_lock);
+
   /* Check that NAME is not in use. */
   if (lookup (dir, name, NULL, NULL)) {
     goto done;
@@ -308,7 +311,7 @@ dir_add (struct dir *dir, const struct canon_path *cpath, const char *name, bloc
   dentry_cache_append(cpath, 1, inode_get_inumber(dir->inode));
 
  done:
- lock_release(&dir_lock);
+ rwlock_release_write(&dir_lock);
   return success;
 }
 
@@ -326,7 +329,7 @@ dir_remove (struct dir *dir, const char *name)
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
-  lock_acquire(&dir_lock);
+  rwlock_acquire_write(&dir_lock);
   /* Find directory entry. */
   if (!lookup(dir, name, &e, &ofs))
     goto done;
@@ -363,7 +366,7 @@ dir_remove (struct dir *dir, const char *name)
 
  done:
   inode_close(inode);
-  lock_release(&dir_lock);
+  rwlock_release_write(&dir_lock);
   return success;
 }
 
@@ -374,17 +377,17 @@ bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
 {
   struct dir_entry e;
-  lock_acquire(&dir_lock);
+  rwlock_acquire_read(&dir_lock);
   while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
     {
       dir->pos += sizeof e;
       if (e.in_use)
         {
           strlcpy (name, e.name, NAME_MAX + 1);
-          lock_release(&dir_lock);
+          rwlock_release_read(&dir_lock);
           return true;
         } 
     }
-  lock_release(&dir_lock);
+  rwlock_release_read(&dir_lock);
   return false;
 }
\ No newline at end of file
@@ -7,6 +7,7 @@
 #include "filesys/free-map.h"
 #include "filesys/bcache.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "threads/synch.h"
 
 /* Identifies an inode. */
@@ -38,7 +39,7 @@ bytes_to_sectors (off_t size)
 struct inode 
   {
     struct list_elem elem;              /* Element in inode list. */
-    struct lock lock;                   /* Lock for synchronizing file expansion/deletion */
+    struct rwlock lock;                 /* Written for file expansion, read for reads past EOF */
     block_sector_t sector;              /* Sector number of disk location. */
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
@@ -59,6 +60,12 @@ struct inode
 #define SECTOR_INVALID -1
 
 static uint8_t ZEROS[BLOCK_SECTOR_SIZE];
+
+/* Caches for in-memory inodes and for sector-sized buffers. */
+static struct kmem_cache inode_cache;
+static struct kmem_cache sector_cache;
+
+static void inode_ctor(void *);
 static block_sector_t byte_to_sector(const struct inode *inode, off_t pos);
 static bool inode_expand_sectors(struct inode *inode, off_t new_size, bool *destructive);
 static bool inode_expand(struct inode *inode, off_t new_size);
@@ -82,7 +89,7 @@ byte_to_sector (const struct inode *inode, off_t pos)
   if (pos >= inode->data.length) {
     return sector;
   }
-  if ((sector_array = calloc(1, BLOCK_SECTOR_SIZE)) == NULL) {
+  if ((sector_array = kmem_cache_zalloc(&sector_cache)) == NULL) {
     return sector;
   }
 
@@ -112,7 +119,7 @@ byte_to_sector (const struct inode *inode, off_t pos)
     }
   }
 done:
-  free(sector_array);
+  kmem_cache_free(&sector_cache, sector_array);
   return sector;    
 }
 
@@ -155,7 +162,7 @@ static bool inode_expand_sectors(struct inode *inode, off_t new_size, bool *dest
   block_sector_t i, j, cnt_lv1, cnt_lv2, rem;
   bool success;
   success = false;
-  if ((buffer = calloc(1,BLOCK_SECTOR_SIZE)) == NULL) {
+  if ((buffer = kmem_cache_zalloc(&sector_cache)) == NULL) {
     success = false;
     return success;
   }
@@ -216,7 +223,7 @@ static bool inode_expand_sectors(struct inode *inode, off_t new_size, bool *dest
           goto done;
         }
         else {
-          if ((sector_array = calloc(1,BLOCK_SECTOR_SIZE)) == NULL) {
+          if ((sector_array = kmem_cache_zalloc(&sector_cache)) == NULL) {
             success = false;
             goto done;
           }
@@ -225,7 +232,7 @@ static bool inode_expand_sectors(struct inode *inode, off_t new_size, bool *dest
           for (i = num_sectors_ori; i < num_sectors_new; i++) {
             if (!free_map_allocate(1,&sector_array[i])) {
               success = false;
-              free(sector_array);
+              kmem_cache_free(&sector_cache, sector_array);
               goto done;
             }
             else {
@@ -238,7 +245,7 @@ static bool inode_expand_sectors(struct inode *inode, off_t new_size, bool *dest
           bcache_write(inode->data.start, sector_array);
           // update disk_inode
           bcache_write(inode->sector, &inode->data);
-          free(sector_array);
+          kmem_cache_free(&sector_cache, sector_array);
           *destructive = false;
           success = true;
           goto done;
@@ -263,12 +270,12 @@ static bool inode_expand_sectors(struct inode *inode, off_t new_size, bool *dest
           goto done;
         }
         else {
-          if ((sector_array1 = calloc(1,BLOCK_SECTOR_SIZE)) == NULL) {
+          if ((sector_array1 = kmem_cache_zalloc(&sector_cache)) == NULL) {
             success = false;
             goto done;
           }
-          if ((sector_array2 = calloc(1,BLOCK_SECTOR_SIZE)) == NULL) {
-            free(sector_array1);
+          if ((sector_array2 = kmem_cache_zalloc(&sector_cache)) == NULL) {
+            kmem_cache_free(&sector_cache, sector_array1);
             success = false;
             goto done;
           }
@@ -282,8 +289,8 @@ static bool inode_expand_sectors(struct inode *inode, off_t new_size, bool *dest
             bcache_read(sector_array1[cnt_lv1_ori-1], sector_array2);
             for (i = cnt_lv2_ori; i < cnt_lv2_new; i++) {
               if (!free_map_allocate(1, &sector_array2[i])) {
-                free(sector_array1);
-                free(sector_array2);
+                kmem_cache_free(&sector_cache, sector_array1);
+                kmem_cache_free(&sector_cache, sector_array2);
                 success = false;
                 goto done;
               }
@@ -309,8 +316,8 @@ static bool inode_expand_sectors(struct inode *inode, off_t new_size, bool *dest
               for (i = cnt_lv2_ori; i < SECTORS_PER_ARRAY; i++) {
                 if (!free_map_allocate(1,&sector_array2[i])) {
                   success = false;
-                  free(sector_array1);
-                  free(sector_array2);
+                  kmem_cache_free(&sector_cache, sector_array1);
+                  kmem_cache_free(&sector_cache, sector_array2);
                   goto done;
                 }
                 else {
@@ -328,16 +335,16 @@ static bool inode_expand_sectors(struct inode *inode, off_t new_size, bool *dest
             for (i = cnt_lv1_ori; i < cnt_lv1_new; i++) {
               if (!free_map_allocate(1,&sector_array1[i])) {
                 success = false;
-                free(sector_array1);
-                free(sector_array2);
+                kmem_cache_free(&sector_cache, sector_array1);
+                kmem_cache_free(&sector_cache, sector_array2);
                 goto done;
               }
               bcache_read(sector_array1[i], sector_array2);
               for (j = 0; j < (i == cnt_lv1_new-1 ? cnt_lv2_new : SECTORS_PER_ARRAY); j++) {
                 if (!free_map_allocate(1,&sector_array2[j])) {
                   success = false;
-                  free(sector_array1);
-                  free(sector_array2);
+                  kmem_cache_free(&sector_cache, sector_array1);
+                  kmem_cache_free(&sector_cache, sector_array2);
                   goto done;
                 }
                 else {
@@ -367,7 +374,7 @@ static bool inode_expand_sectors(struct inode *inode, off_t new_size, bool *dest
     }
   }
 done:
-  free(buffer);
+  kmem_cache_free(&sector_cache, buffer);
   return success;
 }
 
@@ -385,7 +392,7 @@ static bool inode_expand(struct inode *inode, off_t new_size) {
   
   // Linearization -> Writeback only needs to be performed when the type of the inode has been altered
   // For example, from small->large or large->huge. In other cases, it is not necessary
-  // Linearize original buffer. This call should NEVER trigger 'expand' because it will cause assertion lock_held_by_current_thread
+  // Linearize original buffer. This call should NEVER trigger 'expand' because it will trip the assertion in rwlock_acquire_read
   if (destructive_pred) {
     if ((original_data = calloc(1,original_length)) == NULL) {
       success = false;
@@ -401,7 +408,7 @@ static bool inode_expand(struct inode *inode, off_t new_size) {
       goto done;
     }
     ASSERT(destructive_pred == destructive_real);
-    // Copy the original data to the new inode. This call should NEVER trigger 'expand' because it will cause assertion lock_held_by_current_thread.
+    // Copy the original data to the new inode. This call should NEVER trigger 'expand' because it will deadlock in rwlock_acquire_write.
     if (inode_write_at(inode, original_data, original_length, 0) != original_length) {
       success = false;
       goto done;
@@ -432,7 +439,7 @@ static bool inode_create_small(block_sector_t sector, off_t length, uint8_t func
   struct inode_disk *disk_inode;
   size_t sectors;
 
-  if ((disk_inode = calloc(1, sizeof(*disk_inode))) == NULL) {
+  if ((disk_inode = kmem_cache_zalloc(&sector_cache)) == NULL) {
     goto done;
   }
   sectors = bytes_to_sectors(length);
@@ -448,7 +455,6 @@ static bool inode_create_small(block_sector_t sector, off_t length, uint8_t func
         bcache_write(disk_inode->start+i, ZEROS);
       }
     }
-    free(disk_inode);
     success = true;
     goto done;
   }
@@ -456,6 +462,7 @@ static bool inode_create_small(block_sector_t sector, off_t length, uint8_t func
     goto done;
   }
 done:
+  kmem_cache_free(&sector_cache, disk_inode);
   return success;
 }
 
@@ -465,12 +472,12 @@ static bool inode_create_large(block_sector_t sector, off_t length, uint8_t func
   block_sector_t cnt_lv1, arr_lv1, i;
   block_sector_t *sector_array;
   bool success = false;
-  if ((disk_inode = calloc(1, sizeof(*disk_inode))) == NULL) {
+  if ((disk_inode = kmem_cache_zalloc(&sector_cache)) == NULL) {
     success = false;
     return success;
   }
-  if ((sector_array = calloc(1,BLOCK_SECTOR_SIZE)) == NULL) {
-    free(disk_inode);
+  if ((sector_array = kmem_cache_zalloc(&sector_cache)) == NULL) {
+    kmem_cache_free(&sector_cache, disk_inode);
     success = false;
     return success;
   }
@@ -505,7 +512,8 @@ static bool inode_create_large(block_sector_t sector, off_t length, uint8_t func
   bcache_write(sector, disk_inode);
   success = true;
 done:
-  free(sector_array);
+  kmem_cache_free(&sector_cache, disk_inode);
+  kmem_cache_free(&sector_cache, sector_array);
   return success;
 }
 
@@ -515,18 +523,18 @@ static bool inode_create_huge(block_sector_t sector, off_t length, uint8_t func_
   block_sector_t num_sectors, cnt_lv1, arr_lv1, cnt_lv2, i, j;
   block_sector_t *sector_array1, *sector_array2;
   bool success = false;
-  if ((disk_inode = calloc(1, sizeof(*disk_inode))) == NULL) {
+  if ((disk_inode = kmem_cache_zalloc(&sector_cache)) == NULL) {
     success = false;
     return success;
   }
-  if ((sector_array1 = calloc(1,BLOCK_SECTOR_SIZE)) == NULL) {
-    free(disk_inode);
+  if ((sector_array1 = kmem_cache_zalloc(&sector_cache)) == NULL) {
+    kmem_cache_free(&sector_cache, disk_inode);
     success = false;
     return success;
   }
-  if ((sector_array2 = calloc(1,BLOCK_SECTOR_SIZE)) == NULL) {
-    free(disk_inode);
-    free(sector_array1);
+  if ((sector_array2 = kmem_cache_zalloc(&sector_cache)) == NULL) {
+    kmem_cache_free(&sector_cache, disk_inode);
+    kmem_cache_free(&sector_cache, sector_array1);
     success = false;
     return success;
   }
@@ -573,11 +581,21 @@ static bool inode_create_huge(block_sector_t sector, off_t length, uint8_t func_
   bcache_write(sector, disk_inode);
   success = true;
 done:
-  free(sector_array1);
-  free(sector_array2);
+  kmem_cache_free(&sector_cache, disk_inode);
+  kmem_cache_free(&sector_cache, sector_array1);
+  kmem_cache_free(&sector_cache, sector_array2);
   return success;
 }
 
+/* Constructs a cached inode.  Its lock is free whenever the
+   inode is, so it stays initialized across reuse. */
+static void
+inode_ctor (void *inode_)
+{
+  struct inode *inode = inode_;
+  rwlock_init(&inode->lock);
+}
+
 /* Initializes the inode module. */
 void
 inode_init (void) 
@@ -585,6 +603,8 @@ inode_init (void)
   ASSERT(sizeof(struct inode_disk) == BLOCK_SECTOR_SIZE);
   list_init(&open_inodes);
   lock_init(&open_inodes_lock);
+  kmem_cache_init(&inode_cache, "inode", sizeof(struct inode), 0, inode_ctor);
+  kmem_cache_init(&sector_cache, "sector", BLOCK_SECTOR_SIZE, 0, NULL);
   bcache_init();
 }
 
@@ -638,7 +658,7 @@ inode_open (block_sector_t sector)
     }
 
   /* Allocate memory. */
-  inode = malloc (sizeof *inode);
+  inode = kmem_cache_alloc (&inode_cache);
   if (inode == NULL) {
     goto done;
   }
@@ -648,7 +668,6 @@ inode_open (block_sector_t sector)
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
-  lock_init(&inode->lock);
   bcache_read(inode->sector, &inode->data);
   list_push_front(&open_inodes, &inode->elem);
 done:
@@ -703,7 +722,7 @@ inode_close (struct inode *inode)
           //free_map_release (inode->data.start,
           //                  bytes_to_sectors (inode->data.length)); 
         }
-      free(inode); 
+      kmem_cache_free(&inode_cache, inode);
     }
     lock_release(&open_inodes_lock);
 }
@@ -728,13 +747,13 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
   uint8_t *bounce_buffer;
   bool expand;
 
-  if ((bounce_buffer = calloc(1,BLOCK_SECTOR_SIZE)) == NULL) {
+  if ((bounce_buffer = kmem_cache_zalloc(&sector_cache)) == NULL) {
     return 0;
   }
   
   expand = (offset + size) > inode->data.length;
   if (expand) {
-    lock_acquire(&inode->lock);
+    rwlock_acquire_read(&inode->lock);
   }
 
   while (size > 0) {
@@ -766,10 +785,10 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
   }
 
   if (expand) {
-    lock_release(&inode->lock);
+    rwlock_release_read(&inode->lock);
   }
 
-  free(bounce_buffer);
+  kmem_cache_free(&sector_cache, bounce_buffer);
   return bytes_read;
 }
 
@@ -791,9 +810,9 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size, off_t offs
 
   expand = (offset + size) > inode->data.length;
   if (expand) {
-    lock_acquire(&inode->lock);
+    rwlock_acquire_write(&inode->lock);
     if (!inode_expand(inode, size+offset)) {
-      lock_release(&inode->lock);
+      rwlock_release_write(&inode->lock);
       return 0;
     }
   }
@@ -825,7 +844,7 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size, off_t offs
   }
 
   if (expand) {
-    lock_release(&inode->lock);
+    rwlock_release_write(&inode->lock);
   }
 
   return bytes_written;
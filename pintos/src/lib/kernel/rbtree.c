@@ -0,0 +1,388 @@
+#include "rbtree.h"
+#include "../debug.h"
+
+/* The algorithms are those of [CLRS] chapter 13, "Red-Black
+   Trees", with null pointers in place of the sentinel leaf.
+   Null children count as black. */
+
+static void rotate_left (struct rb_tree *, struct rb_elem *);
+static void rotate_right (struct rb_tree *, struct rb_elem *);
+static void transplant (struct rb_tree *, struct rb_elem *old,
+                        struct rb_elem *new);
+static void insert_fixup (struct rb_tree *, struct rb_elem *);
+static void remove_fixup (struct rb_tree *, struct rb_elem *,
+                          struct rb_elem *parent);
+static struct rb_elem *subtree_min (struct rb_elem *);
+static struct rb_elem *subtree_max (struct rb_elem *);
+
+/* Returns true if E is non-null and red. */
+static inline bool
+is_red (const struct rb_elem *e) 
+{
+  return e != NULL && e->red;
+}
+
+/* Initializes TREE as an empty tree ordered by LESS given
+   auxiliary data AUX. */
+void
+rb_init (struct rb_tree *tree, rb_less_func *less, void *aux) 
+{
+  ASSERT (tree != NULL);
+  ASSERT (less != NULL);
+
+  tree->root = NULL;
+  tree->first = NULL;
+  tree->elem_cnt = 0;
+  tree->less = less;
+  tree->aux = aux;
+}
+
+/* Inserts E into TREE.  E is placed after any elements that
+   compare equal to it. */
+void
+rb_insert (struct rb_tree *tree, struct rb_elem *e) 
+{
+  struct rb_elem **link = &tree->root;
+  struct rb_elem *parent = NULL;
+  bool leftmost = true;
+
+  ASSERT (tree != NULL);
+  ASSERT (e != NULL);
+
+  while (*link != NULL) 
+    {
+      parent = *link;
+      if (tree->less (e, parent, tree->aux))
+        link = &parent->left;
+      else 
+        {
+          link = &parent->right;
+          leftmost = false;
+        }
+    }
+
+  e->parent = parent;
+  e->left = e->right = NULL;
+  e->red = true;
+  *link = e;
+  if (leftmost)
+    tree->first = e;
+  tree->elem_cnt++;
+
+  insert_fixup (tree, e);
+}
+
+/* Removes E from TREE.  E must be in TREE. */
+void
+rb_remove (struct rb_tree *tree, struct rb_elem *e) 
+{
+  struct rb_elem *x, *x_parent;
+  bool removed_red;
+
+  ASSERT (tree != NULL);
+  ASSERT (e != NULL);
+  ASSERT (tree->elem_cnt > 0);
+
+  if (tree->first == e)
+    tree->first = rb_next (e);
+
+  if (e->left == NULL) 
+    {
+      /* Replace E by its right subtree. */
+      removed_red = e->red;
+      x = e->right;
+      x_parent = e->parent;
+      transplant (tree, e, e->right);
+    }
+  else if (e->right == NULL) 
+    {
+      /* Replace E by its left subtree. */
+      removed_red = e->red;
+      x = e->left;
+      x_parent = e->parent;
+      transplant (tree, e, e->left);
+    }
+  else 
+    {
+      /* Replace E by its successor Y, which has no left child,
+         and Y by its right subtree. */
+      struct rb_elem *y = subtree_min (e->right);
+      removed_red = y->red;
+      x = y->right;
+      if (y->parent == e)
+        x_parent = y;
+      else 
+        {
+          x_parent = y->parent;
+          transplant (tree, y, y->right);
+          y->right = e->right;
+          y->right->parent = y;
+        }
+      transplant (tree, e, y);
+      y->left = e->left;
+      y->left->parent = y;
+      y->red = e->red;
+    }
+  tree->elem_cnt--;
+
+  if (!removed_red)
+    remove_fixup (tree, x, x_parent);
+}
+
+/* Returns the minimum element in TREE, or a null pointer if
+   TREE is empty.  Takes constant time. */
+struct rb_elem *
+rb_first (const struct rb_tree *tree) 
+{
+  ASSERT (tree != NULL);
+  return tree->first;
+}
+
+/* Returns the maximum element in TREE, or a null pointer if
+   TREE is empty. */
+struct rb_elem *
+rb_last (const struct rb_tree *tree) 
+{
+  ASSERT (tree != NULL);
+  return tree->root != NULL ? subtree_max (tree->root) : NULL;
+}
+
+/* Returns the element after E in its tree, or a null pointer if
+   E is the maximum element. */
+struct rb_elem *
+rb_next (const struct rb_elem *e) 
+{
+  ASSERT (e != NULL);
+
+  if (e->right != NULL)
+    return subtree_min (e->right);
+  while (e->parent != NULL && e == e->parent->right)
+    e = e->parent;
+  return e->parent;
+}
+
+/* Returns the element before E in its tree, or a null pointer
+   if E is the minimum element. */
+struct rb_elem *
+rb_prev (const struct rb_elem *e) 
+{
+  ASSERT (e != NULL);
+
+  if (e->left != NULL)
+    return subtree_max (e->left);
+  while (e->parent != NULL && e == e->parent->left)
+    e = e->parent;
+  return e->parent;
+}
+
+/* Returns the number of elements in TREE. */
+size_t
+rb_size (const struct rb_tree *tree) 
+{
+  return tree->elem_cnt;
+}
+
+/* Returns true if TREE is empty, false otherwise. */
+bool
+rb_empty (const struct rb_tree *tree) 
+{
+  return tree->elem_cnt == 0;
+}
+
+/* Makes X's right child take X's place, with X as its left
+   child. */
+static void
+rotate_left (struct rb_tree *tree, struct rb_elem *x) 
+{
+  struct rb_elem *y = x->right;
+
+  x->right = y->left;
+  if (y->left != NULL)
+    y->left->parent = x;
+  transplant (tree, x, y);
+  y->left = x;
+  x->parent = y;
+}
+
+/* Makes X's left child take X's place, with X as its right
+   child. */
+static void
+rotate_right (struct rb_tree *tree, struct rb_elem *x) 
+{
+  struct rb_elem *y = x->left;
+
+  x->left = y->right;
+  if (y->right != NULL)
+    y->right->parent = x;
+  transplant (tree, x, y);
+  y->right = x;
+  x->parent = y;
+}
+
+/* Links NEW, which may be null, into the place of OLD in OLD's
+   parent.  OLD's own links are not changed. */
+static void
+transplant (struct rb_tree *tree, struct rb_elem *old, struct rb_elem *new) 
+{
+  if (old->parent == NULL)
+    tree->root = new;
+  else if (old == old->parent->left)
+    old->parent->left = new;
+  else
+    old->parent->right = new;
+  if (new != NULL)
+    new->parent = old->parent;
+}
+
+/* Restores the red-black properties after red element E was
+   inserted. */
+static void
+insert_fixup (struct rb_tree *tree, struct rb_elem *e) 
+{
+  while (is_red (e->parent)) 
+    {
+      struct rb_elem *p = e->parent;
+      struct rb_elem *g = p->parent;   /* Non-null: P is red, so not the root. */
+
+      if (p == g->left) 
+        {
+          struct rb_elem *uncle = g->right;
+          if (is_red (uncle)) 
+            {
+              p->red = uncle->red = false;
+              g->red = true;
+              e = g;
+            }
+          else 
+            {
+              if (e == p->right) 
+                {
+                  e = p;
+                  rotate_left (tree, e);
+                  p = e->parent;
+                }
+              p->red = false;
+              g->red = true;
+              rotate_right (tree, g);
+            }
+        }
+      else 
+        {
+          struct rb_elem *uncle = g->left;
+          if (is_red (uncle)) 
+            {
+              p->red = uncle->red = false;
+              g->red = true;
+              e = g;
+            }
+          else 
+            {
+              if (e == p->left) 
+                {
+                  e = p;
+                  rotate_right (tree, e);
+                  p = e->parent;
+                }
+              p->red = false;
+              g->red = true;
+              rotate_left (tree, g);
+            }
+        }
+    }
+  tree->root->red = false;
+}
+
+/* Restores the red-black properties after a black element was
+   removed from the position now held by X, whose parent is
+   PARENT.  X may be null. */
+static void
+remove_fixup (struct rb_tree *tree, struct rb_elem *x, struct rb_elem *parent) 
+{
+  while (x != tree->root && !is_red (x)) 
+    {
+      if (x == parent->left) 
+        {
+          struct rb_elem *w = parent->right;
+          if (is_red (w)) 
+            {
+              w->red = false;
+              parent->red = true;
+              rotate_left (tree, parent);
+              w = parent->right;
+            }
+          if (!is_red (w->left) && !is_red (w->right)) 
+            {
+              w->red = true;
+              x = parent;
+              parent = x->parent;
+            }
+          else 
+            {
+              if (!is_red (w->right)) 
+                {
+                  w->left->red = false;
+                  w->red = true;
+                  rotate_right (tree, w);
+                  w = parent->right;
+                }
+              w->red = parent->red;
+              parent->red = false;
+              w->right->red = false;
+              rotate_left (tree, parent);
+              x = tree->root;
+            }
+        }
+      else 
+        {
+          struct rb_elem *w = parent->left;
+          if (is_red (w)) 
+            {
+              w->red = false;
+              parent->red = true;
+              rotate_right (tree, parent);
+              w = parent->left;
+            }
+          if (!is_red (w->left) && !is_red (w->right)) 
+            {
+              w->red = true;
+              x = parent;
+              parent = x->parent;
+            }
+          else 
+            {
+              if (!is_red (w->left)) 
+                {
+                  w->right->red = false;
+                  w->red = true;
+                  rotate_left (tree, w);
+                  w = parent->left;
+                }
+              w->red = parent->red;
+              parent->red = false;
+              w->left->red = false;
+              rotate_right (tree, parent);
+              x = tree->root;
+            }
+        }
+    }
+  if (x != NULL)
+    x->red = false;
+}
+
+/* Returns the minimum element in the subtree rooted at E. */
+static struct rb_elem *
+subtree_min (struct rb_elem *e) 
+{
+  while (e->left != NULL)
+    e = e->left;
+  return e;
+}
+
+/* Returns the maximum element in the subtree rooted at E. */
+static struct rb_elem *
+subtree_max (struct rb_elem *e) 
+{
+  while (e->right != NULL)
+    e = e->right;
+  return e;
+}
@@ -0,0 +1,77 @@
+#ifndef __LIB_KERNEL_RBTREE_H
+#define __LIB_KERNEL_RBTREE_H
+
+/* Red-black tree.
+
+   A balanced binary search tree: insertion and removal take
+   O(log n) time, and the minimum element is cached so that
+   finding it takes constant time.  This makes it a good fit for
+   priority queues whose keys are not small integers, such as a
+   run queue ordered by virtual runtime.
+
+   Like lists and hash tables, the tree does not allocate
+   memory.  Each structure that can be in a tree embeds a struct
+   rb_elem member, and the rb_entry macro converts a struct
+   rb_elem back into the structure that contains it.  Refer to
+   lib/kernel/list.h for a detailed explanation of the
+   technique.
+
+   Elements are ordered by a caller-supplied "less" function.
+   Elements that compare equal are kept in insertion order, so
+   the tree can serve as a FIFO among equal keys. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Red-black tree element. */
+struct rb_elem 
+  {
+    struct rb_elem *parent;     /* Parent, or null for the root. */
+    struct rb_elem *left;       /* Left child, or null. */
+    struct rb_elem *right;      /* Right child, or null. */
+    bool red;                   /* Red or black? */
+  };
+
+/* Converts pointer to tree element RB_ELEM into a pointer to
+   the structure that RB_ELEM is embedded inside.  Supply the
+   name of the outer structure STRUCT and the member name MEMBER
+   of the tree element. */
+#define rb_entry(RB_ELEM, STRUCT, MEMBER)                       \
+        ((STRUCT *) ((uint8_t *) &(RB_ELEM)->parent             \
+                     - offsetof (STRUCT, MEMBER.parent)))
+
+/* Compares the value of two tree elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, or
+   false if A is greater than or equal to B. */
+typedef bool rb_less_func (const struct rb_elem *a,
+                           const struct rb_elem *b,
+                           void *aux);
+
+/* Red-black tree. */
+struct rb_tree 
+  {
+    struct rb_elem *root;       /* Root, or null if empty. */
+    struct rb_elem *first;      /* Minimum element, or null if empty. */
+    size_t elem_cnt;            /* Number of elements in tree. */
+    rb_less_func *less;         /* Comparison function. */
+    void *aux;                  /* Auxiliary data for `less'. */
+  };
+
+void rb_init (struct rb_tree *, rb_less_func *, void *aux);
+
+/* Insertion and removal. */
+void rb_insert (struct rb_tree *, struct rb_elem *);
+void rb_remove (struct rb_tree *, struct rb_elem *);
+
+/* Traversal, in ascending order. */
+struct rb_elem *rb_first (const struct rb_tree *);
+struct rb_elem *rb_last (const struct rb_tree *);
+struct rb_elem *rb_next (const struct rb_elem *);
+struct rb_elem *rb_prev (const struct rb_elem *);
+
+/* Information. */
+size_t rb_size (const struct rb_tree *);
+bool rb_empty (const struct rb_tree *);
+
+#endif /* lib/kernel/rbtree.h */
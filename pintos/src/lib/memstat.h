@@ -0,0 +1,66 @@
+#ifndef __LIB_MEMSTAT_H
+#define __LIB_MEMSTAT_H
+
+#include <stddef.h>
+
+/* Kernel memory statistics, shared between the kernel and user
+   programs through the memstat system call. */
+
+/* Subsystems that kernel memory is charged to.  Each kernel
+   source file is charged to the directory it lives in. */
+enum mem_tag
+  {
+    MEM_TAG_OTHER,              /* Libraries, devices, tests. */
+    MEM_TAG_THREADS,            /* threads/. */
+    MEM_TAG_USERPROG,           /* userprog/. */
+    MEM_TAG_VM,                 /* vm/. */
+    MEM_TAG_FILESYS,            /* filesys/. */
+    MEM_TAG_MALLOC,             /* Pages backing malloc() itself. */
+    MEM_TAG_CNT                 /* Number of tags. */
+  };
+
+/* Number of malloc() size classes. */
+#define MEMSTAT_CLASS_CNT 7
+
+/* A page pool. */
+struct memstat_pool
+  {
+    size_t page_cnt;            /* Pages in the pool. */
+    size_t free_cnt;            /* Free pages. */
+    size_t largest_free;        /* Pages in the largest free block. */
+    size_t zeroed_cnt;          /* Free pages already zeroed. */
+    size_t zero_hits;           /* Zeroed page requests served from
+                                   pages zeroed in the background. */
+    size_t zero_misses;         /* Zeroed page requests zeroed inline. */
+  };
+
+/* A malloc() size class. */
+struct memstat_class
+  {
+    size_t block_size;          /* Bytes per block. */
+    size_t arena_cnt;           /* Arenas, one page each. */
+    size_t in_use;              /* Blocks allocated. */
+    size_t cached;              /* Free blocks held by threads' magazines
+                                   and the depot. */
+    size_t requested;           /* Bytes requested for blocks in use. */
+  };
+
+/* Memory charged to one subsystem. */
+struct memstat_tag
+  {
+    size_t pages;               /* Pages from either pool. */
+    size_t heap_blocks;         /* malloc() blocks in use. */
+    size_t heap_requested;      /* Bytes requested for them. */
+    size_t heap_allocated;      /* Bytes allocated for them. */
+  };
+
+/* All kernel memory statistics. */
+struct memstat
+  {
+    struct memstat_pool kernel_pool;
+    struct memstat_pool user_pool;
+    struct memstat_class classes[MEMSTAT_CLASS_CNT];
+    struct memstat_tag tags[MEM_TAG_CNT];
+  };
+
+#endif /* lib/memstat.h */
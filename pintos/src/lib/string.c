@@ -1,5 +1,41 @@
 #include <string.h>
 #include <debug.h>
+#include <stdint.h>
+
+/* memcpy(), memset(), memcmp(), memchr(), and strlen() work a
+   32-bit word at a time rather than a byte at a time, since they
+   run on every hot path: buffer cache copies, zeroed pages,
+   copies to and from user memory.  For all but small sizes,
+   memcpy() and memset() align the destination with a few
+   single-byte moves, then use "rep movsl" or "rep stosl" for the
+   bulk, then finish the tail a byte at a time.  The string
+   instructions rely on the direction flag being clear, which the
+   ABI guarantees and the interrupt entry code ensures.
+
+   tests/internal/string.c checks these against the obvious
+   byte-at-a-time versions and compares their speed. */
+
+/* A word that may alias any other type, for reading memory a
+   word at a time. */
+typedef uint32_t __attribute__ ((may_alias)) word_t;
+
+/* Below this many bytes, word-wide loops and string
+   instructions are not worth setting up. */
+#define SMALL_SIZE 32
+
+/* Returns a word with each byte set to BYTE. */
+static inline word_t
+repeat_byte (unsigned char byte) 
+{
+  return byte * 0x01010101u;
+}
+
+/* Returns nonzero if any byte in W is zero. */
+static inline word_t
+has_zero_byte (word_t w) 
+{
+  return (w - 0x01010101u) & ~w & 0x80808080u;
+}
 
 /* Copies SIZE bytes from SRC to DST, which must not overlap.
    Returns DST. */
@@ -12,6 +48,17 @@ memcpy (void *dst_, const void *src_, size_t size)
   ASSERT (dst != NULL || size == 0);
   ASSERT (src != NULL || size == 0);
 
+  if (size >= SMALL_SIZE) 
+    {
+      size_t words;
+
+      for (; (uintptr_t) dst % sizeof (word_t) != 0; size--)
+        *dst++ = *src++;
+      words = size / sizeof (word_t);
+      size %= sizeof (word_t);
+      asm volatile ("rep movsl"
+                    : "+D" (dst), "+S" (src), "+c" (words) : : "memory");
+    }
   while (size-- > 0)
     *dst++ = *src++;
 
@@ -58,6 +105,16 @@ memcmp (const void *a_, const void *b_, size_t size)
   ASSERT (a != NULL || size == 0);
   ASSERT (b != NULL || size == 0);
 
+  /* Skip over equal words; the byte loop below then finds the
+     difference, if any, within the next word. */
+  for (; size >= sizeof (word_t); size -= sizeof (word_t))
+    {
+      if (*(const word_t *) a != *(const word_t *) b)
+        break;
+      a += sizeof (word_t);
+      b += sizeof (word_t);
+    }
+
   for (; size-- > 0; a++, b++)
     if (*a != *b)
       return *a > *b ? +1 : -1;
@@ -98,6 +155,24 @@ memchr (const void *block_, int ch_, size_t size)
 
   ASSERT (block != NULL || size == 0);
 
+  if (size >= SMALL_SIZE) 
+    {
+      word_t pattern = repeat_byte (ch);
+
+      /* Check bytes up to a word boundary. */
+      for (; (uintptr_t) block % sizeof (word_t) != 0; size--, block++)
+        if (*block == ch)
+          return (void *) block;
+
+      /* Skip words that do not contain CH. */
+      for (; size >= sizeof (word_t); size -= sizeof (word_t))
+        {
+          if (has_zero_byte (*(const word_t *) block ^ pattern))
+            break;
+          block += sizeof (word_t);
+        }
+    }
+
   for (; size-- > 0; block++)
     if (*block == ch)
       return (void *) block;
@@ -281,7 +356,19 @@ memset (void *dst_, int value, size_t size)
   unsigned char *dst = dst_;
 
   ASSERT (dst != NULL || size == 0);
-  
+
+  if (size >= SMALL_SIZE) 
+    {
+      size_t words;
+
+      for (; (uintptr_t) dst % sizeof (word_t) != 0; size--)
+        *dst++ = value;
+      words = size / sizeof (word_t);
+      size %= sizeof (word_t);
+      asm volatile ("rep stosl"
+                    : "+D" (dst), "+c" (words)
+                    : "a" (repeat_byte (value)) : "memory");
+    }
   while (size-- > 0)
     *dst++ = value;
 
@@ -296,7 +383,17 @@ strlen (const char *string)
 
   ASSERT (string != NULL);
 
-  for (p = string; *p != '\0'; p++)
+  /* Check bytes up to a word boundary.  After that, whole
+     aligned words can be read without running off the end of a
+     page, even past the terminator. */
+  for (p = string; (uintptr_t) p % sizeof (word_t) != 0; p++)
+    if (*p == '\0')
+      return p - string;
+
+  while (!has_zero_byte (*(const word_t *) p))
+    p += sizeof (word_t);
+
+  for (; *p != '\0'; p++)
     continue;
   return p - string;
 }
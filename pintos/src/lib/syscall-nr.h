@@ -31,7 +31,11 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Kernel statistics. */
+    SYS_LOCKSTAT,               /* Print lock contention statistics. */
+    SYS_MEMSTAT                 /* Get kernel memory statistics. */
   };
 
 #endif /* lib/syscall-nr.h */
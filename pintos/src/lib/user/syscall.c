@@ -197,3 +197,15 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+bool
+lockstat (void) 
+{
+  return syscall0 (SYS_LOCKSTAT);
+}
+
+bool
+memstat (struct memstat *ms) 
+{
+  return syscall1 (SYS_MEMSTAT, ms);
+}
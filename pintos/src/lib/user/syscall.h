@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 #include <debug.h>
+#include <memstat.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -51,4 +52,8 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Kernel statistics. */
+bool lockstat (void);
+bool memstat (struct memstat *);
+
 #endif /* lib/user/syscall.h */
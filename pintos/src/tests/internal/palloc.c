@@ -0,0 +1,131 @@
+/* Test and microbenchmark for threads/palloc.c.
+
+   Allocates and frees runs of user pages of random sizes in
+   random order, checking that live runs never overlap and that
+   freeing everything coalesces the pool back to its initial
+   shape.  Along the way, reports the average cost of an
+   allocation and of a free in CPU cycles, and how fragmented the
+   pool got, as the share of free pages outside the largest free
+   block.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <random.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/palloc.h"
+#include "threads/test.h"
+#include "threads/tsc.h"
+#include "threads/vaddr.h"
+
+/* Number of runs live at once, at most. */
+#define SLOT_CNT 64
+
+/* Largest run to allocate, in pages. */
+#define MAX_PAGES 16
+
+/* Number of allocate-or-free steps. */
+#define STEP_CNT 20000
+
+/* A run of pages. */
+struct run 
+  {
+    uint8_t *pages;             /* First page, or a null pointer. */
+    size_t page_cnt;            /* Number of pages. */
+  };
+
+static void fill_run (struct run *, int slot);
+static void check_run (const struct run *, int slot);
+
+/* Test the page allocator. */
+void
+test (void) 
+{
+  static struct run runs[SLOT_CNT];
+  struct palloc_stats before, after, stats;
+  uint64_t alloc_cycles = 0, free_cycles = 0;
+  unsigned alloc_cnt = 0, free_cnt = 0;
+  unsigned worst_frag = 0;
+  int step, i;
+
+  palloc_get_stats (PAL_USER, &before);
+
+  for (step = 0; step < STEP_CNT; step++) 
+    {
+      int slot = random_ulong () % SLOT_CNT;
+      struct run *r = &runs[slot];
+      uint64_t start;
+
+      if (r->pages == NULL) 
+        {
+          r->page_cnt = random_ulong () % MAX_PAGES + 1;
+          start = rdtsc ();
+          r->pages = palloc_get_multiple (PAL_USER, r->page_cnt);
+          alloc_cycles += rdtsc () - start;
+          alloc_cnt++;
+          if (r->pages != NULL)
+            fill_run (r, slot);
+        }
+      else 
+        {
+          check_run (r, slot);
+          start = rdtsc ();
+          palloc_free_multiple (r->pages, r->page_cnt);
+          free_cycles += rdtsc () - start;
+          free_cnt++;
+          r->pages = NULL;
+        }
+
+      palloc_get_stats (PAL_USER, &stats);
+      if (stats.free_cnt > 0) 
+        {
+          unsigned frag = (stats.free_cnt - stats.largest_free) * 100
+                          / stats.free_cnt;
+          if (frag > worst_frag)
+            worst_frag = frag;
+        }
+    }
+
+  for (i = 0; i < SLOT_CNT; i++)
+    if (runs[i].pages != NULL) 
+      {
+        check_run (&runs[i], i);
+        palloc_free_multiple (runs[i].pages, runs[i].page_cnt);
+        runs[i].pages = NULL;
+      }
+
+  palloc_get_stats (PAL_USER, &after);
+  ASSERT (after.free_cnt == before.free_cnt);
+  ASSERT (after.largest_free == before.largest_free);
+
+  printf ("palloc: %u allocations, %llu cycles each\n",
+          alloc_cnt, alloc_cnt ? alloc_cycles / alloc_cnt : 0);
+  printf ("palloc: %u frees, %llu cycles each\n",
+          free_cnt, free_cnt ? free_cycles / free_cnt : 0);
+  printf ("palloc: worst fragmentation %u%% of free pages\n", worst_frag);
+  printf ("palloc: PASS\n");
+}
+
+/* Marks every page of R as belonging to SLOT. */
+static void
+fill_run (struct run *r, int slot) 
+{
+  size_t i;
+
+  for (i = 0; i < r->page_cnt; i++)
+    r->pages[i * PGSIZE] = slot;
+}
+
+/* Checks that no other run overwrote the marks in R. */
+static void
+check_run (const struct run *r, int slot) 
+{
+  size_t i;
+
+  for (i = 0; i < r->page_cnt; i++)
+    ASSERT (r->pages[i * PGSIZE] == slot);
+}
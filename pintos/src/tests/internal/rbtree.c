@@ -0,0 +1,139 @@
+/* Test program for lib/kernel/rbtree.c.
+
+   Inserts and removes elements in random order and checks after
+   every operation that the tree is ordered, balanced, and keeps
+   equal elements in insertion order.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <random.h>
+#include <rbtree.h>
+#include <stdio.h>
+#include "threads/test.h"
+
+/* Maximum number of elements in a tree that we will test. */
+#define MAX_SIZE 64
+
+/* A tree element. */
+struct value 
+  {
+    struct rb_elem elem;        /* Tree element. */
+    int value;                  /* Item value, the sort key. */
+    int seq;                    /* Order of insertion. */
+    bool in_tree;               /* Currently in the tree? */
+  };
+
+static bool value_less (const struct rb_elem *, const struct rb_elem *,
+                        void *);
+static int verify_subtree (struct rb_elem *, struct rb_elem *parent);
+static void verify_tree (struct rb_tree *);
+
+/* Test the red-black tree implementation. */
+void
+test (void) 
+{
+  int size;
+
+  printf ("testing various size trees:");
+  for (size = 1; size <= MAX_SIZE; size++) 
+    {
+      static struct value values[MAX_SIZE];
+      struct rb_tree tree;
+      int seq = 0;
+      int i;
+
+      printf (" %d", size);
+      rb_init (&tree, value_less, NULL);
+      for (i = 0; i < size; i++)
+        values[i].in_tree = false;
+
+      /* Toggle random elements in and out of the tree.  Keys are
+         drawn from a small range so that there are many
+         duplicates. */
+      for (i = 0; i < size * 20; i++) 
+        {
+          struct value *v = &values[random_ulong () % size];
+          if (v->in_tree)
+            rb_remove (&tree, &v->elem);
+          else 
+            {
+              v->value = random_ulong () % 8;
+              v->seq = seq++;
+              rb_insert (&tree, &v->elem);
+            }
+          v->in_tree = !v->in_tree;
+          verify_tree (&tree);
+        }
+    }
+  
+  printf (" done\n");
+  printf ("rbtree: PASS\n");
+}
+
+/* Returns true if value A is less than value B, false
+   otherwise. */
+static bool
+value_less (const struct rb_elem *a_, const struct rb_elem *b_,
+            void *aux UNUSED) 
+{
+  const struct value *a = rb_entry (a_, struct value, elem);
+  const struct value *b = rb_entry (b_, struct value, elem);
+  
+  return a->value < b->value;
+}
+
+/* Verifies the links and colors of the subtree rooted at E,
+   whose parent should be PARENT, and returns its black
+   height. */
+static int
+verify_subtree (struct rb_elem *e, struct rb_elem *parent) 
+{
+  int left, right;
+
+  if (e == NULL)
+    return 1;
+  ASSERT (e->parent == parent);
+  if (e->red)
+    ASSERT ((e->left == NULL || !e->left->red)
+            && (e->right == NULL || !e->right->red));
+  left = verify_subtree (e->left, e);
+  right = verify_subtree (e->right, e);
+  ASSERT (left == right);
+  return left + !e->red;
+}
+
+/* Verifies that TREE is a valid red-black tree whose in-order
+   traversal, both forward and backward, visits its elements
+   ordered by value and then by insertion order. */
+static void
+verify_tree (struct rb_tree *tree) 
+{
+  struct value *prev = NULL;
+  struct rb_elem *e;
+  size_t cnt;
+
+  ASSERT (tree->root == NULL || !tree->root->red);
+  verify_subtree (tree->root, NULL);
+
+  cnt = 0;
+  for (e = rb_first (tree); e != NULL; e = rb_next (e)) 
+    {
+      struct value *v = rb_entry (e, struct value, elem);
+      ASSERT (v->in_tree);
+      if (prev != NULL)
+        ASSERT (prev->value < v->value
+                || (prev->value == v->value && prev->seq < v->seq));
+      prev = v;
+      cnt++;
+    }
+  ASSERT (cnt == rb_size (tree));
+
+  cnt = 0;
+  for (e = rb_last (tree); e != NULL; e = rb_prev (e))
+    cnt++;
+  ASSERT (cnt == rb_size (tree));
+}
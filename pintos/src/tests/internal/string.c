@@ -0,0 +1,317 @@
+/* Test program for the memory and string functions in
+   lib/string.c.
+
+   Checks memcpy(), memset(), memcmp(), memchr(), and strlen()
+   against straightforward byte-at-a-time reference versions,
+   which are how lib/string.c used to implement them, over every
+   combination of alignment and a range of sizes, and checks
+   that nothing outside the destination is touched.  Then
+   reports the cycles each version takes on some typical sizes:
+   a buffer cache sector and a page.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <random.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/test.h"
+#include "threads/tsc.h"
+
+/* Largest size we test exhaustively. */
+#define MAX_SIZE 300
+
+/* Alignments we test, as offsets from a word boundary. */
+#define ALIGN_CNT 8
+
+/* Size of each test buffer, with room for alignment and guard
+   bytes on either side. */
+#define BUF_SIZE (4096 + 64)
+
+/* Guard byte value. */
+#define GUARD 0xa5
+
+static unsigned char buf_a[BUF_SIZE], buf_b[BUF_SIZE], buf_c[BUF_SIZE];
+
+static void *ref_memcpy (void *, const void *, size_t);
+static void *ref_memset (void *, int, size_t);
+static int ref_memcmp (const void *, const void *, size_t);
+static void *ref_memchr (const void *, int, size_t);
+static size_t ref_strlen (const char *);
+
+static void test_memcpy (void);
+static void test_memset (void);
+static void test_memcmp (void);
+static void test_memchr (void);
+static void test_strlen (void);
+static void benchmark (void);
+
+/* Test the memory and string functions. */
+void
+test (void) 
+{
+  test_memcpy ();
+  test_memset ();
+  test_memcmp ();
+  test_memchr ();
+  test_strlen ();
+  benchmark ();
+  printf ("string: PASS\n");
+}
+
+/* Fills BUF with random bytes. */
+static void
+randomize (unsigned char *buf, size_t size) 
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    buf[i] = random_ulong ();
+}
+
+/* Checks that all bytes of BUF outside [OFS, OFS + SIZE) are
+   GUARD. */
+static void
+check_guards (const unsigned char *buf, size_t ofs, size_t size) 
+{
+  size_t i;
+
+  for (i = 0; i < ofs; i++)
+    ASSERT (buf[i] == GUARD);
+  for (i = ofs + size; i < BUF_SIZE; i++)
+    ASSERT (buf[i] == GUARD);
+}
+
+static void
+test_memcpy (void) 
+{
+  size_t size, src_ofs, dst_ofs;
+
+  randomize (buf_a, BUF_SIZE);
+  for (size = 0; size <= MAX_SIZE; size++)
+    for (src_ofs = 0; src_ofs < ALIGN_CNT; src_ofs++)
+      for (dst_ofs = 0; dst_ofs < ALIGN_CNT; dst_ofs++) 
+        {
+          ref_memset (buf_b, GUARD, BUF_SIZE);
+          ASSERT (memcpy (buf_b + 8 + dst_ofs, buf_a + src_ofs, size)
+                  == buf_b + 8 + dst_ofs);
+          ASSERT (!ref_memcmp (buf_b + 8 + dst_ofs, buf_a + src_ofs, size));
+          check_guards (buf_b, 8 + dst_ofs, size);
+        }
+}
+
+static void
+test_memset (void) 
+{
+  size_t size, ofs;
+
+  for (size = 0; size <= MAX_SIZE; size++)
+    for (ofs = 0; ofs < ALIGN_CNT; ofs++) 
+      {
+        int value = random_ulong ();
+        size_t i;
+
+        ref_memset (buf_b, GUARD, BUF_SIZE);
+        ASSERT (memset (buf_b + 8 + ofs, value, size) == buf_b + 8 + ofs);
+        for (i = 0; i < size; i++)
+          ASSERT (buf_b[8 + ofs + i] == (unsigned char) value);
+        check_guards (buf_b, 8 + ofs, size);
+      }
+}
+
+/* Returns the sign of X: -1, 0, or 1. */
+static int
+sign (int x) 
+{
+  return (x > 0) - (x < 0);
+}
+
+static void
+test_memcmp (void) 
+{
+  size_t size, a_ofs, b_ofs;
+
+  randomize (buf_a, BUF_SIZE);
+  for (size = 0; size <= MAX_SIZE; size++)
+    for (a_ofs = 0; a_ofs < ALIGN_CNT; a_ofs++)
+      for (b_ofs = 0; b_ofs < ALIGN_CNT; b_ofs++) 
+        {
+          unsigned char *a = buf_a + a_ofs, *b = buf_b + b_ofs;
+
+          ref_memcpy (b, a, size);
+          ASSERT (memcmp (a, b, size) == 0);
+          if (size > 0) 
+            {
+              /* Make the blocks differ at a random byte. */
+              size_t at = random_ulong () % size;
+              b[at] = a[at] + 1 + random_ulong () % 255;
+              ASSERT (sign (memcmp (a, b, size))
+                      == sign (ref_memcmp (a, b, size)));
+              ASSERT (sign (memcmp (b, a, size))
+                      == sign (ref_memcmp (b, a, size)));
+            }
+        }
+}
+
+static void
+test_memchr (void) 
+{
+  size_t size, ofs;
+
+  for (size = 0; size <= MAX_SIZE; size++)
+    for (ofs = 0; ofs < ALIGN_CNT; ofs++) 
+      {
+        unsigned char *block = buf_a + ofs;
+        int ch = random_ulong () % 256;
+        size_t i;
+
+        /* Place CH nowhere, then at each possible position. */
+        for (i = 0; i < size; i++)
+          if (block[i] == ch)
+            block[i] = ch + 1;
+        ASSERT (memchr (block, ch, size) == NULL);
+        for (i = 0; i < size; i++) 
+          {
+            unsigned char save = block[i];
+            block[i] = ch;
+            ASSERT (memchr (block, ch, size) == ref_memchr (block, ch, size));
+            ASSERT (memchr (block, ch, size) == block + i);
+            block[i] = save;
+          }
+      }
+}
+
+static void
+test_strlen (void) 
+{
+  size_t size, ofs;
+
+  for (size = 0; size <= MAX_SIZE; size++)
+    for (ofs = 0; ofs < ALIGN_CNT; ofs++) 
+      {
+        char *string = (char *) buf_c + ofs;
+        size_t i;
+
+        for (i = 0; i < size; i++)
+          string[i] = 1 + random_ulong () % 255;
+        string[size] = '\0';
+        ASSERT (strlen (string) == size);
+        ASSERT (ref_strlen (string) == size);
+      }
+}
+
+/* Number of times each benchmark runs. */
+#define BENCH_ITERATIONS 64
+
+/* Keeps the compiler from discarding calls whose results are
+   otherwise unused. */
+static volatile uintptr_t bench_sink;
+
+/* Prints the average cycles that FUNC, the library version, and
+   REF, the reference version, take to run on SIZE bytes. */
+#define BENCH(NAME, SIZE, FUNC, REF)                                    \
+        do                                                              \
+          {                                                             \
+            uint64_t start, func_cycles, ref_cycles;                    \
+            int i;                                                      \
+                                                                        \
+            start = rdtsc ();                                           \
+            for (i = 0; i < BENCH_ITERATIONS; i++)                      \
+              bench_sink = (uintptr_t) (FUNC);                          \
+            func_cycles = (rdtsc () - start) / BENCH_ITERATIONS;        \
+            start = rdtsc ();                                           \
+            for (i = 0; i < BENCH_ITERATIONS; i++)                      \
+              bench_sink = (uintptr_t) (REF);                           \
+            ref_cycles = (rdtsc () - start) / BENCH_ITERATIONS;         \
+            printf ("string: %s of %d bytes: %llu cycles, "              \
+                    "%llu for reference\n",                             \
+                    NAME, SIZE, func_cycles, ref_cycles);               \
+          }                                                             \
+        while (0)
+
+static void
+benchmark (void) 
+{
+  static const int sizes[] = {16, 64, 512, 4096};
+  size_t i;
+
+  randomize (buf_a, BUF_SIZE);
+  ref_memset (buf_c, 'x', BUF_SIZE);
+  buf_c[4096] = '\0';
+  for (i = 0; i < sizeof sizes / sizeof *sizes; i++) 
+    {
+      int size = sizes[i];
+
+      BENCH ("memcpy", size, memcpy (buf_b, buf_a, size),
+             ref_memcpy (buf_b, buf_a, size));
+      BENCH ("memset", size, memset (buf_b, 0, size),
+             ref_memset (buf_b, 0, size));
+      BENCH ("memcmp", size, memcmp (buf_a, buf_b, size),
+             ref_memcmp (buf_a, buf_b, size));
+      BENCH ("memchr", size, memchr (buf_c, 0, size),
+             ref_memchr (buf_c, 0, size));
+    }
+  BENCH ("strlen", 4096, strlen ((char *) buf_c),
+         ref_strlen ((char *) buf_c));
+}
+
+/* Reference versions. */
+
+static void *
+ref_memcpy (void *dst_, const void *src_, size_t size) 
+{
+  unsigned char *dst = dst_;
+  const unsigned char *src = src_;
+
+  while (size-- > 0)
+    *dst++ = *src++;
+  return dst_;
+}
+
+static void *
+ref_memset (void *dst_, int value, size_t size) 
+{
+  unsigned char *dst = dst_;
+
+  while (size-- > 0)
+    *dst++ = value;
+  return dst_;
+}
+
+static int
+ref_memcmp (const void *a_, const void *b_, size_t size) 
+{
+  const unsigned char *a = a_;
+  const unsigned char *b = b_;
+
+  for (; size-- > 0; a++, b++)
+    if (*a != *b)
+      return *a > *b ? +1 : -1;
+  return 0;
+}
+
+static void *
+ref_memchr (const void *block_, int ch_, size_t size) 
+{
+  const unsigned char *block = block_;
+  unsigned char ch = ch_;
+
+  for (; size-- > 0; block++)
+    if (*block == ch)
+      return (void *) block;
+  return NULL;
+}
+
+static size_t
+ref_strlen (const char *string) 
+{
+  const char *p;
+
+  for (p = string; *p != '\0'; p++)
+    continue;
+  return p - string;
+}
@@ -0,0 +1,45 @@
+/* Arms a kernel timer whose callback re-arms it for the tick it
+   is running in, which has already come.  Each re-arm must wait
+   for the next tick rather than fire again in the same pass of
+   the timer wheel, so the callback runs once per tick. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define FIRE_CNT 10
+
+static struct timer_event event;
+static int64_t fired_at[FIRE_CNT];
+static int fire_cnt;
+
+static void
+rearm (void *aux UNUSED) 
+{
+  fired_at[fire_cnt++] = timer_ticks ();
+  if (fire_cnt < FIRE_CNT)
+    timer_event_arm (&event, timer_ticks ());
+}
+
+void
+test_alarm_rearm (void) 
+{
+  int i;
+
+  timer_event_init (&event, rearm, NULL);
+  timer_sleep (1);
+  timer_event_arm (&event, timer_ticks () + 1);
+  timer_sleep (FIRE_CNT + 5);
+
+  if (fire_cnt != FIRE_CNT)
+    fail ("callback ran %d times, expected %d", fire_cnt, FIRE_CNT);
+  for (i = 1; i < FIRE_CNT; i++)
+    if (fired_at[i] != fired_at[i - 1] + 1)
+      fail ("run %d at tick %"PRId64", run %d at tick %"PRId64,
+            i - 1, fired_at[i - 1], i, fired_at[i]);
+  pass ();
+}
@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(alarm-rearm) begin
+(alarm-rearm) PASS
+(alarm-rearm) end
+EOF
+pass;
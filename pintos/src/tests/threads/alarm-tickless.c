@@ -0,0 +1,43 @@
+/* Tests timer_sleep() with the timer tick stopped while idle
+   ("-tickless").  The main thread is the only thread, so the CPU
+   idles for the whole of each sleep, and the ticks skipped while
+   idle must still be counted: every sleep has to end exactly at
+   the tick it was due, no earlier and no later.  Some of the
+   sleeps are long enough to cross wraparounds of the timer
+   wheel. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+static const int64_t durations[] = {1, 2, 3, 5, 7, 10, 64, 130};
+
+void
+test_alarm_tickless (void) 
+{
+  size_t i;
+
+  ASSERT (timer_tickless);
+
+  for (i = 0; i < sizeof durations / sizeof *durations; i++) 
+    {
+      int64_t start, elapsed;
+
+      /* Sleep from the start of a tick, so that the tick
+         cannot advance between reading it and going to
+         sleep. */
+      timer_sleep (1);
+      start = timer_ticks ();
+      timer_sleep (durations[i]);
+      elapsed = timer_elapsed (start);
+
+      if (elapsed != durations[i])
+        fail ("slept %"PRId64" ticks, expected %"PRId64,
+              elapsed, durations[i]);
+      msg ("sleep %zu ok", i);
+    }
+}
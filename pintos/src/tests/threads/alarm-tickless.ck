@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(alarm-tickless) begin
+(alarm-tickless) sleep 0 ok
+(alarm-tickless) sleep 1 ok
+(alarm-tickless) sleep 2 ok
+(alarm-tickless) sleep 3 ok
+(alarm-tickless) sleep 4 ok
+(alarm-tickless) sleep 5 ok
+(alarm-tickless) sleep 6 ok
+(alarm-tickless) sleep 7 ok
+(alarm-tickless) end
+EOF
+pass;
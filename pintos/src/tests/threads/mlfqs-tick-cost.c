@@ -0,0 +1,102 @@
+/* Measures the cost of a timer tick under the MLFQS scheduler
+   as the number of threads grows.
+
+   Creates 10, then 100, then 500 threads, half of which block on
+   a semaphore and half of which spin, so that they stay on the
+   ready queue, and reports the average number of CPU cycles
+   spent in the timer interrupt handler per tick while the main
+   thread sleeps.  Per-tick work only touches the running thread,
+   and the once-per-second decay walks the ready queue once, so
+   the cost should stay roughly flat as the thread count
+   grows. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define MEASURE_TICKS (4 * TIMER_FREQ)
+
+static thread_func blocked_thread;
+static thread_func spinning_thread;
+
+static const int thread_cnts[] = {10, 100, 500};
+
+/* Set to stop the spinning threads. */
+static volatile bool stop;
+
+void
+test_mlfqs_tick_cost (void) 
+{
+  struct semaphore start, done;
+  int created = 0;
+  size_t i;
+  int j;
+
+  ASSERT (thread_mlfqs);
+
+  sema_init (&start, 0);
+  sema_init (&done, 0);
+
+  for (i = 0; i < sizeof thread_cnts / sizeof *thread_cnts; i++) 
+    {
+      int64_t start_ticks, ticks;
+      uint64_t start_cycles, cycles;
+
+      for (; created < thread_cnts[i]; created++) 
+        {
+          char name[16];
+          if (created % 2 == 0) 
+            {
+              snprintf (name, sizeof name, "blocked %d", created);
+              thread_create (name, PRI_DEFAULT, blocked_thread, &start);
+            }
+          else 
+            {
+              snprintf (name, sizeof name, "spinning %d", created);
+              thread_create (name, PRI_DEFAULT, spinning_thread, &done);
+            }
+        }
+
+      /* Let the new threads reach sema_down() or start spinning,
+         and at least one load_avg update go by, before
+         measuring. */
+      timer_sleep (TIMER_FREQ);
+
+      start_ticks = timer_ticks ();
+      start_cycles = timer_interrupt_cycles ();
+      timer_sleep (MEASURE_TICKS);
+      ticks = timer_elapsed (start_ticks);
+      cycles = timer_interrupt_cycles () - start_cycles;
+
+      msg ("%d threads: %"PRIu64" cycles per tick",
+           created, cycles / (uint64_t) ticks);
+    }
+
+  stop = true;
+  for (j = 0; j < created; j++)
+    if (j % 2 == 0)
+      sema_up (&start);
+    else
+      sema_down (&done);
+  timer_sleep (TIMER_FREQ);
+}
+
+static void
+blocked_thread (void *start_) 
+{
+  struct semaphore *start = start_;
+  sema_down (start);
+}
+
+static void
+spinning_thread (void *done_) 
+{
+  struct semaphore *done = done_;
+  while (!stop)
+    continue;
+  sema_up (done);
+}
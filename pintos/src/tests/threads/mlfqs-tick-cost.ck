@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+# Cycle counts depend on the host, so only check that every
+# thread count was measured.
+my (%cycles);
+foreach (@output) {
+    my ($threads, $cycles) = /(\d+) threads: (\d+) cycles per tick/
+      or next;
+    $cycles{$threads} = $cycles;
+}
+foreach my $threads (10, 100, 500) {
+    fail "No measurement for $threads threads.\n"
+      if !defined $cycles{$threads};
+}
+pass;
@@ -0,0 +1,58 @@
+/* The main thread acquires a readers-writer lock for reading.
+   Then it creates a higher-priority thread that blocks acquiring
+   the lock for writing, which must donate its priority to the
+   main thread, the reader it waits for.  A medium-priority
+   thread created next must therefore not run until the main
+   thread releases the lock, after which the writer and then the
+   medium thread run, in that order. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func writer_thread_func;
+static thread_func medium_thread_func;
+
+void
+test_priority_donate_rwlock (void) 
+{
+  struct rwlock rw;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&rw);
+  rwlock_acquire_read (&rw);
+  thread_create ("writer", PRI_DEFAULT + 10, writer_thread_func, &rw);
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 10, thread_get_priority ());
+  thread_create ("medium", PRI_DEFAULT + 5, medium_thread_func, NULL);
+  msg ("Main thread releasing the read lock.");
+  rwlock_release_read (&rw);
+  thread_yield ();
+  msg ("writer, medium must already have finished, in that order.");
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT, thread_get_priority ());
+}
+
+static void
+writer_thread_func (void *rw_) 
+{
+  struct rwlock *rw = rw_;
+
+  rwlock_acquire_write (rw);
+  msg ("writer: got the lock");
+  rwlock_release_write (rw);
+  msg ("writer: done");
+}
+
+static void
+medium_thread_func (void *aux UNUSED) 
+{
+  msg ("medium: done");
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(priority-donate-rwlock) begin
+(priority-donate-rwlock) Main thread should have priority 41.  Actual priority: 41.
+(priority-donate-rwlock) Main thread releasing the read lock.
+(priority-donate-rwlock) writer: got the lock
+(priority-donate-rwlock) writer: done
+(priority-donate-rwlock) medium: done
+(priority-donate-rwlock) writer, medium must already have finished, in that order.
+(priority-donate-rwlock) Main thread should have priority 31.  Actual priority: 31.
+(priority-donate-rwlock) end
+EOF
+pass;
@@ -17,6 +17,8 @@ static const struct test tests[] =
     {"alarm-priority", test_alarm_priority},
     {"alarm-zero", test_alarm_zero},
     {"alarm-negative", test_alarm_negative},
+    {"alarm-tickless", test_alarm_tickless},
+    {"alarm-rearm", test_alarm_rearm},
     {"priority-change", test_priority_change},
     {"priority-donate-one", test_priority_donate_one},
     {"priority-donate-multiple", test_priority_donate_multiple},
@@ -25,6 +27,8 @@ static const struct test tests[] =
     {"priority-donate-sema", test_priority_donate_sema},
     {"priority-donate-lower", test_priority_donate_lower},
     {"priority-donate-chain", test_priority_donate_chain},
+    {"priority-donate-rwlock", test_priority_donate_rwlock},
+    {"workqueue", test_workqueue},
     {"priority-fifo", test_priority_fifo},
     {"priority-preempt", test_priority_preempt},
     {"priority-sema", test_priority_sema},
@@ -38,6 +42,12 @@ static const struct test tests[] =
     {"mlfqs-nice-2", test_mlfqs_nice_2},
     {"mlfqs-nice-10", test_mlfqs_nice_10},
     {"mlfqs-block", test_mlfqs_block},
+    {"mlfqs-tick-cost", test_mlfqs_tick_cost},
+    {"thread-create-cost", test_thread_create_cost},
+    {"cfs-fair-2", test_cfs_fair_2},
+    {"cfs-fair-20", test_cfs_fair_20},
+    {"cfs-nice-2", test_cfs_nice_2},
+    {"cfs-nice-10", test_cfs_nice_10},
   };
 
 static const char *test_name;
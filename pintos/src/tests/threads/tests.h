@@ -11,6 +11,8 @@ extern test_func test_alarm_simultaneous;
 extern test_func test_alarm_priority;
 extern test_func test_alarm_zero;
 extern test_func test_alarm_negative;
+extern test_func test_alarm_tickless;
+extern test_func test_alarm_rearm;
 extern test_func test_priority_change;
 extern test_func test_priority_donate_one;
 extern test_func test_priority_donate_multiple;
@@ -19,6 +21,8 @@ extern test_func test_priority_donate_sema;
 extern test_func test_priority_donate_nest;
 extern test_func test_priority_donate_lower;
 extern test_func test_priority_donate_chain;
+extern test_func test_priority_donate_rwlock;
+extern test_func test_workqueue;
 extern test_func test_priority_fifo;
 extern test_func test_priority_preempt;
 extern test_func test_priority_sema;
@@ -32,6 +36,12 @@ extern test_func test_mlfqs_fair_20;
 extern test_func test_mlfqs_nice_2;
 extern test_func test_mlfqs_nice_10;
 extern test_func test_mlfqs_block;
+extern test_func test_mlfqs_tick_cost;
+extern test_func test_thread_create_cost;
+extern test_func test_cfs_fair_2;
+extern test_func test_cfs_fair_20;
+extern test_func test_cfs_nice_2;
+extern test_func test_cfs_nice_10;
 
 void msg (const char *, ...);
 void fail (const char *, ...);
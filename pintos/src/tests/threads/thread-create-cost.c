@@ -0,0 +1,61 @@
+/* Measures the cost of creating a thread and waiting for it to
+   exit, first with the cache of dead thread pages disabled, so
+   that every thread_create() gets a zeroed page from the page
+   allocator (PAL_ZERO) as it did before the cache, and then with
+   the cache enabled. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/tsc.h"
+
+#define THREAD_CNT 200
+
+static thread_func exit_thread;
+static uint64_t create_join_cycles (void);
+
+void
+test_thread_create_cost (void) 
+{
+  size_t cache_max = thread_page_cache_max;
+
+  thread_page_cache_max = 0;
+  msg ("uncached: %"PRIu64" cycles per create+join", create_join_cycles ());
+
+  thread_page_cache_max = cache_max > 0 ? cache_max : 16;
+  /* Warm the cache. */
+  create_join_cycles ();
+  msg ("cached: %"PRIu64" cycles per create+join", create_join_cycles ());
+
+  thread_page_cache_max = cache_max;
+}
+
+/* Creates THREAD_CNT threads one at a time, waiting for each to
+   finish before creating the next, and returns the average
+   number of cycles per thread. */
+static uint64_t
+create_join_cycles (void) 
+{
+  struct semaphore done;
+  uint64_t start;
+  int i;
+
+  sema_init (&done, 0);
+  start = rdtsc ();
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      thread_create ("child", PRI_DEFAULT, exit_thread, &done);
+      sema_down (&done);
+    }
+  return (rdtsc () - start) / THREAD_CNT;
+}
+
+static void
+exit_thread (void *done_) 
+{
+  struct semaphore *done = done_;
+  sema_up (done);
+}
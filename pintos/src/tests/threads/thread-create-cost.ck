@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+# Cycle counts depend on the host, so only check that both
+# configurations were measured.
+foreach my $kind ('uncached', 'cached') {
+    fail "No measurement for $kind thread pages.\n"
+      if !grep (/\b$kind: \d+ cycles per create\+join/, @output);
+}
+pass;
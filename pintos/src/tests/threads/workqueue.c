@@ -0,0 +1,91 @@
+/* Tests the workqueue: work runs in the order it was queued,
+   queueing pending work again has no effect, flush_workqueue()
+   waits for everything queued, delayed work runs no earlier than
+   its delay, and cancelled delayed work does not run at all. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/workqueue.h"
+#include "devices/timer.h"
+
+#define WORK_CNT 5
+
+static struct workqueue wq;
+static int order[WORK_CNT];
+static int order_cnt;
+
+static struct semaphore delayed_done;
+static int64_t delayed_ran_at;
+static bool cancelled_ran;
+
+static void record_func (void *);
+static void delayed_func (void *);
+static void cancelled_func (void *);
+
+void
+test_workqueue (void) 
+{
+  struct work works[WORK_CNT];
+  struct delayed_work delayed, cancelled;
+  int64_t start;
+  int i;
+
+  /* The worker runs below us, so nothing runs until we block. */
+  if (!workqueue_create (&wq, "test", 1, PRI_MIN))
+    fail ("could not create workqueue");
+
+  for (i = 0; i < WORK_CNT; i++) 
+    {
+      work_init (&works[i], record_func, (void *) i);
+      if (!queue_work (&wq, &works[i]))
+        fail ("could not queue work %d", i);
+    }
+  if (queue_work (&wq, &works[2]))
+    fail ("queued pending work twice");
+  flush_workqueue (&wq);
+  msg ("ran %d items in order %d %d %d %d %d", order_cnt,
+       order[0], order[1], order[2], order[3], order[4]);
+
+  sema_init (&delayed_done, 0);
+  delayed_work_init (&delayed, delayed_func, NULL);
+  delayed_work_init (&cancelled, cancelled_func, NULL);
+  timer_sleep (1);
+  start = timer_ticks ();
+  if (!queue_delayed_work (&wq, &delayed, 10)
+      || !queue_delayed_work (&wq, &cancelled, 5))
+    fail ("could not queue delayed work");
+  if (!cancel_delayed_work (&cancelled))
+    fail ("could not cancel delayed work");
+  sema_down (&delayed_done);
+  if (delayed_ran_at - start < 10)
+    fail ("delayed work ran after %d ticks, expected 10",
+          (int) (delayed_ran_at - start));
+  msg ("delayed work ran after its delay");
+
+  timer_sleep (10);
+  if (cancelled_ran)
+    fail ("cancelled work ran");
+  msg ("cancelled work did not run");
+}
+
+static void
+record_func (void *aux) 
+{
+  order[order_cnt++] = (int) aux;
+}
+
+static void
+delayed_func (void *aux UNUSED) 
+{
+  delayed_ran_at = timer_ticks ();
+  sema_up (&delayed_done);
+}
+
+static void
+cancelled_func (void *aux UNUSED) 
+{
+  cancelled_ran = true;
+}
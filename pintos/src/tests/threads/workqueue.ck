@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(workqueue) begin
+(workqueue) ran 5 items in order 0 1 2 3 4
+(workqueue) delayed work ran after its delay
+(workqueue) cancelled work did not run
+(workqueue) end
+EOF
+pass;
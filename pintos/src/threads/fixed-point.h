@@ -47,6 +47,10 @@ static fixed64 fixed64_mul_int32(fixed64 x1, int x2) {
     return x1*x2_;
 }
 
+static fixed64 fixed64_mul_int64(fixed64 x1, int64_t x2) {
+    return x1*x2;
+}
+
 static fixed64 fixed64_div_int32(fixed64 x1, int x2) {
     fixed64 x2_ = (fixed64)x2;
     return x1/x2_;
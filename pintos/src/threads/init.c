@@ -22,6 +22,8 @@
 #include "threads/palloc.h"
 #include "threads/pte.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
+#include "threads/workqueue.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -38,6 +40,7 @@
 #include "filesys/fsutil.h"
 #endif
 #ifdef VM
+#include "vm/pageout.h"
 #include "vm/vm.h"
 #endif
 
@@ -101,6 +104,7 @@ main (void)
   palloc_init (user_page_limit);
   malloc_init ();
   paging_init ();
+  trace_init ();
 
   /* Segmentation. */
 #ifdef USERPROG
@@ -124,6 +128,8 @@ main (void)
   thread_start ();
   serial_init_queue ();
   timer_calibrate ();
+  workqueue_init ();
+  palloc_start_zeroing ();
 
 #ifdef FILESYS
   /* Initialize file system. */
@@ -266,16 +272,35 @@ parse_options (char **argv)
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-cfs"))
+        thread_cfs = true;
+      else if (!strcmp (name, "-tickless"))
+        timer_tickless = true;
       else if (!strcmp (name, "-reportlatency"))
         thread_report_latency = true;
+      else if (!strcmp (name, "-trace")) 
+        {
+          trace_enabled = true;
+          if (value != NULL)
+            trace_pages = atoi (value);
+        }
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
+#endif
+#ifdef VM
+      else if (!strcmp (name, "-pageout-low"))
+        pageout_low_wm = atoi (value);
+      else if (!strcmp (name, "-pageout-high"))
+        pageout_high_wm = atoi (value);
 #endif
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
     }
 
+  if (thread_mlfqs && thread_cfs)
+    PANIC ("-cfs and -mlfqs are mutually exclusive");
+
   /* Initialize the random number generator based on the system
      time.  This has no effect if an "-rs" option was specified.
 
@@ -391,8 +416,19 @@ usage (void)
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -cfs               Use completely fair scheduler.\n"
+          "                     Cannot be combined with -mlfqs.\n"
+          "  -tickless          Stop the timer tick while the CPU is idle.\n"
+          "  -trace[=PAGES]     Trace events into a PAGES-page buffer and\n"
+          "                     save them to the scratch device at shutdown.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+          "  -pageout-low=LOW, -pageout-high=HIGH\n"
+          "                     Wake the page-out daemon when fewer than\n"
+          "                     LOW user pages are free, and let it evict\n"
+          "                     until HIGH pages are free.\n"
 #endif
           );
   shutdown_power_off ();
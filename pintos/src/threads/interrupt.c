@@ -359,6 +359,10 @@ intr_handler (struct intr_frame *frame)
 
       in_external_intr = true;
       yield_on_return = false;
+
+      /* Bring the clock up to date if this interrupt ended a
+         tickless idle period. */
+      timer_irq_enter ();
     }
 
   /* Invoke the interrupt's handler. */
@@ -0,0 +1,348 @@
+#include "threads/latency.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <list.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/tsc.h"
+
+/* Per-thread scheduling latency statistics, collected when the
+   kernel is started with "-reportlatency".
+
+   All times are in CPU cycles, as read by rdtsc().  Each
+   distribution is kept as a histogram with one bucket per power
+   of 2: a sample of N cycles goes in bucket floor(log2(N)).
+
+   When a thread exits, its statistics are folded into one
+   aggregate for all exited threads and freed, so that the report
+   printed at shutdown still covers every thread that ever ran
+   without keeping a record per dead thread.
+
+   Time spent waiting for locks is also kept per lock_init() call
+   site, so that, for example, the locks of all inodes add up to
+   one entry however often their memory is reused.  The sites are
+   kept in a fixed table, since the hook runs in lock_acquire()
+   and so cannot itself allocate memory.  Sites that find the
+   table full are counted together. */
+
+#define LATENCY_BUCKETS 64
+#define LATENCY_LOCK_MAX 64
+
+/* A log2 histogram. */
+struct latency_hist
+  {
+    uint64_t count;                     /* Number of samples. */
+    uint64_t sum;                       /* Sum of all samples. */
+    uint32_t buckets[LATENCY_BUCKETS];  /* Samples per log2 bucket. */
+  };
+
+/* Statistics for one thread. */
+struct thread_latency
+  {
+    struct list_elem elem;              /* Element in latency_list. */
+    tid_t tid;                          /* Thread's identifier. */
+    char name[16];                      /* Thread's name. */
+
+    struct latency_hist wakeup;         /* From unblock to running. */
+    struct latency_hist slice;          /* From running to switched out. */
+    struct latency_hist lock_wait;      /* Blocked in lock_acquire(). */
+    uint64_t voluntary;                 /* Switches out while blocking. */
+    uint64_t involuntary;               /* Switches out while runnable. */
+
+    uint64_t ready_since;               /* When unblocked, or 0. */
+    uint64_t running_since;             /* When switched in, or 0. */
+  };
+
+/* Statistics for the locks initialized at one call site. */
+struct lock_latency
+  {
+    const char *file;                   /* Source file, or NULL if unused. */
+    int line;                           /* Source line. */
+    struct latency_hist wait;           /* Blocked in lock_acquire(). */
+  };
+
+/* Statistics of live threads, in creation order, and the sum of
+   those of exited threads.  Accessed with interrupts off. */
+static struct list latency_list;
+static struct thread_latency latency_exited;
+static unsigned latency_exited_cnt;
+
+/* Statistics of contended locks by call site, as an
+   open-addressed hash table, and of the sites that did not fit.  Accessed with
+   interrupts off. */
+static struct lock_latency lock_latency[LATENCY_LOCK_MAX];
+static struct latency_hist lock_latency_other;
+
+static const char *strip_dotdot (const char *file);
+static void hist_add (struct latency_hist *, uint64_t cycles);
+static void hist_merge (struct latency_hist *, const struct latency_hist *);
+static void hist_print (const char *owner, const char *kind,
+                        const struct latency_hist *);
+
+/* Initializes latency statistics. */
+void
+latency_init (void) 
+{
+  list_init (&latency_list);
+}
+
+/* Starts collecting statistics for T, if "-reportlatency" was
+   given.  T must not yet be on the run queue, or must be the
+   running thread.  Must be called after malloc_init(). */
+void
+latency_attach (struct thread *t) 
+{
+  struct thread_latency *l;
+  enum intr_level old_level;
+
+  if (!thread_report_latency)
+    return;
+
+  l = calloc (1, sizeof *l);
+  if (l == NULL)
+    return;
+  l->tid = t->tid;
+  strlcpy (l->name, t->name, sizeof l->name);
+  if (t->status == THREAD_RUNNING)
+    l->running_since = rdtsc ();
+
+  old_level = intr_disable ();
+  list_push_back (&latency_list, &l->elem);
+  t->latency = l;
+  intr_set_level (old_level);
+}
+
+/* Notes that T has just been unblocked. */
+void
+latency_ready (struct thread *t) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (t->latency != NULL)
+    t->latency->ready_since = rdtsc ();
+}
+
+/* Accounts for a context switch from PREV, whose status has
+   already been changed from THREAD_RUNNING, to NEXT.  Interrupts
+   must be off. */
+void
+latency_switch (struct thread *prev, struct thread *next) 
+{
+  uint64_t now;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (prev->latency == NULL && next->latency == NULL)
+    return;
+
+  now = rdtsc ();
+  if (prev->latency != NULL) 
+    {
+      struct thread_latency *l = prev->latency;
+      if (l->running_since != 0)
+        hist_add (&l->slice, now - l->running_since);
+      l->running_since = 0;
+      if (prev->status == THREAD_READY)
+        l->involuntary++;
+      else
+        l->voluntary++;
+    }
+  if (next->latency != NULL) 
+    {
+      struct thread_latency *l = next->latency;
+      if (l->ready_since != 0)
+        hist_add (&l->wakeup, now - l->ready_since);
+      l->ready_since = 0;
+      l->running_since = now;
+    }
+}
+
+/* Folds the statistics of T, which is exiting, into those of
+   all exited threads and frees them.  T's current run slice is
+   counted as ending here, with a voluntary switch. */
+void
+latency_exit (struct thread *t) 
+{
+  struct thread_latency *l;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  l = t->latency;
+  t->latency = NULL;
+  if (l != NULL) 
+    {
+      list_remove (&l->elem);
+      if (l->running_since != 0)
+        hist_add (&l->slice, rdtsc () - l->running_since);
+      l->voluntary++;
+
+      hist_merge (&latency_exited.wakeup, &l->wakeup);
+      hist_merge (&latency_exited.slice, &l->slice);
+      hist_merge (&latency_exited.lock_wait, &l->lock_wait);
+      latency_exited.voluntary += l->voluntary;
+      latency_exited.involuntary += l->involuntary;
+      latency_exited_cnt++;
+    }
+  intr_set_level (old_level);
+
+  free (l);
+}
+
+/* Records that T spent CYCLES waiting to acquire LOCK. */
+void
+latency_lock_wait (struct thread *t, const struct lock *lock,
+                   uint64_t cycles) 
+{
+  struct latency_hist *h = &lock_latency_other;
+  enum intr_level old_level;
+  size_t i, n;
+
+  if (t->latency == NULL)
+    return;
+
+  old_level = intr_disable ();
+  hist_add (&t->latency->lock_wait, cycles);
+
+  i = (unsigned) lock->line % LATENCY_LOCK_MAX;
+  for (n = 0; n < LATENCY_LOCK_MAX; n++, i = (i + 1) % LATENCY_LOCK_MAX) 
+    {
+      struct lock_latency *ll = &lock_latency[i];
+
+      if (ll->file == NULL) 
+        {
+          ll->file = lock->file;
+          ll->line = lock->line;
+        }
+      else if (ll->line != lock->line || strcmp (ll->file, lock->file))
+        continue;
+      h = &ll->wait;
+      break;
+    }
+  hist_add (h, cycles);
+  intr_set_level (old_level);
+}
+
+/* Prints the statistics of every thread as a block of
+   machine-readable lines:
+
+     latency begin unit=cycles
+     latency thread tid=TID voluntary=N involuntary=N name=NAME
+     latency hist tid=TID kind=KIND count=N sum=N buckets=B:N,...
+     ...
+     latency exited threads=N voluntary=N involuntary=N
+     latency hist exited kind=KIND count=N sum=N buckets=B:N,...
+     ...
+     latency hist lock=FILE:LINE kind=wait count=N sum=N buckets=B:N,...
+     ...
+     latency hist lock=other kind=wait count=N sum=N buckets=B:N,...
+     latency end
+
+   For threads, KIND is "wakeup", "slice", or "lock".  FILE:LINE
+   is the lock_init() call site of the locks waited for.  Each B:N pair says that
+   N samples were at least 2**B and less than 2**(B+1) cycles;
+   empty buckets are omitted. */
+void
+latency_print_stats (void) 
+{
+  struct list_elem *e;
+  char owner[64];
+  size_t i;
+
+  if (!thread_report_latency)
+    return;
+
+  printf ("latency begin unit=cycles\n");
+  for (e = list_begin (&latency_list); e != list_end (&latency_list);
+       e = list_next (e)) 
+    {
+      struct thread_latency *l = list_entry (e, struct thread_latency, elem);
+      printf ("latency thread tid=%d voluntary=%"PRIu64" involuntary=%"PRIu64
+              " name=%s\n", l->tid, l->voluntary, l->involuntary, l->name);
+      snprintf (owner, sizeof owner, "tid=%d", l->tid);
+      hist_print (owner, "wakeup", &l->wakeup);
+      hist_print (owner, "slice", &l->slice);
+      hist_print (owner, "lock", &l->lock_wait);
+    }
+
+  printf ("latency exited threads=%u voluntary=%"PRIu64" involuntary=%"PRIu64
+          "\n", latency_exited_cnt, latency_exited.voluntary,
+          latency_exited.involuntary);
+  hist_print ("exited", "wakeup", &latency_exited.wakeup);
+  hist_print ("exited", "slice", &latency_exited.slice);
+  hist_print ("exited", "lock", &latency_exited.lock_wait);
+
+  for (i = 0; i < LATENCY_LOCK_MAX; i++)
+    if (lock_latency[i].file != NULL) 
+      {
+        snprintf (owner, sizeof owner, "lock=%s:%d",
+                  strip_dotdot (lock_latency[i].file), lock_latency[i].line);
+        hist_print (owner, "wait", &lock_latency[i].wait);
+      }
+  if (lock_latency_other.count != 0)
+    hist_print ("lock=other", "wait", &lock_latency_other);
+  printf ("latency end\n");
+}
+
+/* Returns FILE without any leading "../" components. */
+static const char *
+strip_dotdot (const char *file) 
+{
+  while (file[0] == '.' && file[1] == '.' && file[2] == '/')
+    file += 3;
+  return file;
+}
+
+/* Adds a sample of CYCLES to H. */
+static void
+hist_add (struct latency_hist *h, uint64_t cycles) 
+{
+  uint32_t hi = cycles >> 32;
+  uint32_t lo = cycles;
+  int bucket;
+
+  if (hi != 0)
+    bucket = 63 - __builtin_clz (hi);
+  else if (lo != 0)
+    bucket = 31 - __builtin_clz (lo);
+  else
+    bucket = 0;
+
+  h->count++;
+  h->sum += cycles;
+  h->buckets[bucket]++;
+}
+
+/* Adds the samples in FROM to TO. */
+static void
+hist_merge (struct latency_hist *to, const struct latency_hist *from) 
+{
+  int i;
+
+  to->count += from->count;
+  to->sum += from->sum;
+  for (i = 0; i < LATENCY_BUCKETS; i++)
+    to->buckets[i] += from->buckets[i];
+}
+
+/* Prints H, which is OWNER's histogram of the given KIND. */
+static void
+hist_print (const char *owner, const char *kind,
+            const struct latency_hist *h) 
+{
+  const char *sep = "";
+  int i;
+
+  printf ("latency hist %s kind=%s count=%"PRIu64" sum=%"PRIu64" buckets=",
+          owner, kind, h->count, h->sum);
+  for (i = 0; i < LATENCY_BUCKETS; i++)
+    if (h->buckets[i] != 0) 
+      {
+        printf ("%s%d:%"PRIu32, sep, i, h->buckets[i]);
+        sep = ",";
+      }
+  printf ("\n");
+}
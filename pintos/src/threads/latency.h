@@ -0,0 +1,18 @@
+#ifndef THREADS_LATENCY_H
+#define THREADS_LATENCY_H
+
+#include <stdint.h>
+
+struct lock;
+struct thread;
+
+void latency_init (void);
+void latency_attach (struct thread *);
+void latency_ready (struct thread *);
+void latency_switch (struct thread *prev, struct thread *next);
+void latency_exit (struct thread *);
+void latency_lock_wait (struct thread *, const struct lock *,
+                        uint64_t cycles);
+void latency_print_stats (void);
+
+#endif /* threads/latency.h */
@@ -0,0 +1,169 @@
+#include "threads/lockstat.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/tsc.h"
+
+#ifdef LOCKSTAT
+/* Lock contention statistics, collected for every struct lock
+   when the kernel is built with "make LOCKSTAT=1".
+
+   Locks are grouped into classes by the call site of
+   lock_init(), so that, for example, the locks of all in-memory
+   inodes are counted together instead of one entry per inode.
+   Classes live in a fixed table, since lock_init() runs before
+   malloc() is available; locks initialized after the table fills
+   up are not profiled.
+
+   All times are in CPU cycles, as read by rdtsc().  Statistics
+   are updated with interrupts off. */
+
+#define LOCKSTAT_CLASS_MAX 128
+
+/* Statistics for the locks initialized at one call site. */
+struct lock_class
+  {
+    const char *name;           /* lock_init() argument, as written. */
+    const char *file;           /* Source file of the call. */
+    int line;                   /* Source line of the call. */
+    unsigned instances;         /* Number of lock_init() calls. */
+    uint64_t acquisitions;      /* Successful acquisitions. */
+    uint64_t contended;         /* Acquisitions that found it held. */
+    uint64_t wait_cycles;       /* Total time blocked acquiring. */
+    uint64_t max_hold_cycles;   /* Longest time held. */
+  };
+
+static struct lock_class classes[LOCKSTAT_CLASS_MAX];
+static size_t class_cnt;
+static unsigned dropped_cnt;    /* lock_init() calls left unprofiled. */
+
+/* Returns the class of locks initialized as NAME at FILE:LINE,
+   creating it if necessary, or a null pointer if the table is
+   full. */
+struct lock_class *
+lockstat_register (const char *name, const char *file, int line) 
+{
+  struct lock_class *c = NULL;
+  enum intr_level old_level;
+  size_t i;
+
+  old_level = intr_disable ();
+  for (i = 0; i < class_cnt; i++)
+    if (classes[i].line == line && !strcmp (classes[i].file, file))
+      {
+        c = &classes[i];
+        break;
+      }
+  if (c == NULL && class_cnt < LOCKSTAT_CLASS_MAX) 
+    {
+      c = &classes[class_cnt++];
+      c->name = name;
+      c->file = file;
+      c->line = line;
+    }
+  if (c != NULL)
+    c->instances++;
+  else
+    dropped_cnt++;
+  intr_set_level (old_level);
+  return c;
+}
+
+/* Records that the current thread acquired LOCK, after blocking
+   for WAIT_CYCLES if CONTENDED. */
+void
+lockstat_acquired (struct lock *lock, bool contended, uint64_t wait_cycles) 
+{
+  struct lock_class *c = lock->class;
+  enum intr_level old_level;
+
+  lock->acquired_at = rdtsc ();
+  if (c == NULL)
+    return;
+
+  old_level = intr_disable ();
+  c->acquisitions++;
+  if (contended) 
+    {
+      c->contended++;
+      c->wait_cycles += wait_cycles;
+    }
+  intr_set_level (old_level);
+}
+
+/* Records that the current thread is releasing LOCK. */
+void
+lockstat_released (struct lock *lock) 
+{
+  struct lock_class *c = lock->class;
+  uint64_t hold = rdtsc () - lock->acquired_at;
+  enum intr_level old_level;
+
+  if (c == NULL)
+    return;
+
+  old_level = intr_disable ();
+  if (hold > c->max_hold_cycles)
+    c->max_hold_cycles = hold;
+  intr_set_level (old_level);
+}
+
+/* Returns FILE without any leading "../" components. */
+static const char *
+strip_dotdot (const char *file) 
+{
+  while (file[0] == '.' && file[1] == '.' && file[2] == '/')
+    file += 3;
+  return file;
+}
+
+/* Prints lock statistics, most total wait time first.  Returns
+   true. */
+bool
+lockstat_print (void) 
+{
+  static struct lock_class snapshot[LOCKSTAT_CLASS_MAX];
+  enum intr_level old_level;
+  size_t cnt, i, j;
+
+  /* Copy the table so that printing does not disturb it, then
+     insertion sort by total wait time. */
+  old_level = intr_disable ();
+  cnt = class_cnt;
+  memcpy (snapshot, classes, cnt * sizeof *snapshot);
+  intr_set_level (old_level);
+  for (i = 1; i < cnt; i++) 
+    {
+      struct lock_class c = snapshot[i];
+      for (j = i; j > 0 && snapshot[j - 1].wait_cycles < c.wait_cycles; j--)
+        snapshot[j] = snapshot[j - 1];
+      snapshot[j] = c;
+    }
+
+  printf ("lockstat begin unit=cycles\n");
+  for (i = 0; i < cnt; i++) 
+    {
+      const struct lock_class *c = &snapshot[i];
+      printf ("lock %s at %s:%d: %u instances, %"PRIu64" acquisitions, "
+              "%"PRIu64" contended, %"PRIu64" wait, %"PRIu64" max hold\n",
+              c->name, strip_dotdot (c->file), c->line, c->instances,
+              c->acquisitions, c->contended, c->wait_cycles,
+              c->max_hold_cycles);
+    }
+  if (dropped_cnt > 0)
+    printf ("lockstat: %u locks not profiled, class table full\n",
+            dropped_cnt);
+  printf ("lockstat end\n");
+  return true;
+}
+#else /* !LOCKSTAT */
+/* Lock profiling is not compiled in: returns false. */
+bool
+lockstat_print (void) 
+{
+  return false;
+}
+#endif /* !LOCKSTAT */
@@ -0,0 +1,23 @@
+#ifndef THREADS_LOCKSTAT_H
+#define THREADS_LOCKSTAT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Lock contention profiling.  Compiled in only when the kernel
+   is built with "make LOCKSTAT=1", which defines LOCKSTAT; the
+   hooks below are then called from threads/synch.c. */
+
+struct lock;
+struct lock_class;
+
+#ifdef LOCKSTAT
+struct lock_class *lockstat_register (const char *name, const char *file,
+                                      int line);
+void lockstat_acquired (struct lock *, bool contended, uint64_t wait_cycles);
+void lockstat_released (struct lock *);
+#endif
+
+bool lockstat_print (void);
+
+#endif /* threads/lockstat.h */
@@ -5,8 +5,10 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
 
 /* A simple implementation of malloc().
@@ -32,17 +34,52 @@
    because they're too big to fit in a single page with a
    descriptor.  We handle those by allocating contiguous pages
    with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   the beginning of the allocated block's arena header.
+
+   Taking a descriptor's lock on every call is costly for code
+   that allocates and frees the same few blocks over and over,
+   so each thread also keeps a "magazine" of free blocks per
+   descriptor, a chain that only that thread touches and so
+   needs no lock.  malloc() takes a block from the current
+   thread's magazine and free() puts one back.  Only when a
+   magazine runs dry does malloc() take the lock, to load a
+   batch of blocks ("rounds") at once: a full batch parked in
+   the descriptor's "depot" by some other thread if there is
+   one, otherwise blocks from the arenas.  Likewise, when a
+   magazine holds two batches' worth, free() moves one batch to
+   the depot, or back to the arenas if the depot is already
+   full.  Blocks in magazines and in the depot count as in use
+   as far as their arenas are concerned, and a thread's
+   magazines go back to the arenas when it exits.
+
+   For the kernel memory report (see memstat.h), each arena
+   records, in a table between its header and its blocks, the
+   number of bytes requested for each block in use and the
+   subsystem it was charged to.  Arena pages themselves are
+   charged to MEM_TAG_MALLOC. */
 
 /* Descriptor. */
 struct desc
   {
     size_t block_size;          /* Size of each element in bytes. */
     size_t blocks_per_arena;    /* Number of blocks in an arena. */
+    size_t first_ofs;           /* Offset of first block in an arena. */
     struct list free_list;      /* List of free blocks. */
+    size_t mag_rounds;          /* Blocks per depot exchange. */
+    struct mag_block *depot;    /* Stack of full batches. */
+    size_t depot_cnt;           /* Number of batches in depot. */
     struct lock lock;           /* Lock. */
+
+    /* Statistics. */
+    size_t arena_cnt;           /* Number of arenas. */
+    size_t free_blocks;         /* Blocks in free_list. */
+    size_t in_use;              /* Blocks allocated (atomic). */
+    size_t requested;           /* Bytes requested for them (atomic). */
   };
 
+/* Largest number of batches kept in a descriptor's depot. */
+#define DEPOT_MAX 4
+
 /* Magic number for detecting arena corruption. */
 #define ARENA_MAGIC 0x9a548eed
 
@@ -52,20 +89,48 @@ struct arena
     unsigned magic;             /* Always set to ARENA_MAGIC. */
     struct desc *desc;          /* Owning descriptor, null for big block. */
     size_t free_cnt;            /* Free blocks; pages in big block. */
+    size_t big_size;            /* Bytes requested for big block. */
+    enum mem_tag big_tag;       /* Subsystem charged for big block. */
   };
 
+/* Entry in an arena's block table: the subsystem charged for a
+   block in use, in the top bits, and the bytes requested for
+   it. */
+typedef uint16_t block_info;
+#define INFO_TAG_SHIFT 12
+#define INFO_SIZE_MASK ((1u << INFO_TAG_SHIFT) - 1)
+
 /* Free block. */
 struct block 
   {
     struct list_elem free_elem; /* Free list element. */
   };
 
+/* Free block in a magazine or the depot, overlaying struct
+   block. */
+struct mag_block 
+  {
+    struct mag_block *next;     /* Next block in batch or magazine. */
+    struct mag_block *next_batch; /* Next batch in depot. */
+  };
+
 /* Our set of descriptors. */
-static struct desc descs[10];   /* Descriptors. */
+static struct desc descs[MALLOC_CLASS_CNT]; /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
+/* Heap memory charged to each subsystem.  Updated atomically,
+   since malloc() and free() mostly run without a lock. */
+static struct memstat_tag heap_tags[MEM_TAG_CNT];
+
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static struct block *arena_alloc_block (struct desc *);
+static void arena_free_block (struct desc *, struct block *);
+static bool magazine_load (struct desc *, struct malloc_magazine *);
+static void magazine_unload (struct desc *, struct malloc_magazine *);
+static block_info *block_to_info (struct arena *, struct block *);
+static void account (struct desc *, enum mem_tag, size_t size,
+                     size_t allocated, int sign);
 
 /* Initializes the malloc() descriptors. */
 void
@@ -78,20 +143,48 @@ malloc_init (void)
       struct desc *d = &descs[desc_cnt++];
       ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
       d->block_size = block_size;
-      d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
+
+      /* Fit as many blocks as we can after the arena header and
+         their block_info table, keeping blocks 8-byte aligned. */
+      d->blocks_per_arena = ((PGSIZE - sizeof (struct arena))
+                             / (block_size + sizeof (block_info)));
+      for (;;) 
+        {
+          d->first_ofs = ROUND_UP (sizeof (struct arena)
+                                   + d->blocks_per_arena
+                                   * sizeof (block_info), 8);
+          if (d->first_ofs + d->blocks_per_arena * block_size <= PGSIZE)
+            break;
+          d->blocks_per_arena--;
+        }
       list_init (&d->free_list);
+      d->mag_rounds = 1024 / block_size;
+      if (d->mag_rounds > 8)
+        d->mag_rounds = 8;
+      if (d->mag_rounds < 2)
+        d->mag_rounds = 2;
+      d->depot = NULL;
+      d->depot_cnt = 0;
       lock_init (&d->lock);
+      d->arena_cnt = d->free_blocks = d->in_use = d->requested = 0;
     }
+  ASSERT (desc_cnt == MALLOC_CLASS_CNT);
+  ASSERT (MEM_TAG_CNT <= 1u << (16 - INFO_TAG_SHIFT));
 }
 
-/* Obtains and returns a new block of at least SIZE bytes.
+/* Obtains and returns a new block of at least SIZE bytes,
+   charging it to TAG.  Most callers use malloc(), which charges
+   the caller's subsystem.
    Returns a null pointer if memory is not available. */
 void *
-malloc (size_t size) 
+malloc_tagged (size_t size, enum mem_tag tag) 
 {
   struct desc *d;
-  struct block *b;
   struct arena *a;
+  struct malloc_magazine *m;
+  struct mag_block *mb;
+
+  ASSERT (tag < MEM_TAG_CNT);
 
   /* A null pointer satisfies a request for 0 bytes. */
   if (size == 0)
@@ -107,7 +200,7 @@ malloc (size_t size)
       /* SIZE is too big for any descriptor.
          Allocate enough pages to hold SIZE plus an arena. */
       size_t page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
-      a = palloc_get_multiple (0, page_cnt);
+      a = palloc_get_multiple_tagged (0, page_cnt, MEM_TAG_MALLOC);
       if (a == NULL)
         return NULL;
 
@@ -116,47 +209,33 @@ malloc (size_t size)
       a->magic = ARENA_MAGIC;
       a->desc = NULL;
       a->free_cnt = page_cnt;
+      a->big_size = size;
+      a->big_tag = tag;
+      account (NULL, tag, size, page_cnt * PGSIZE, 1);
       return a + 1;
     }
 
-  lock_acquire (&d->lock);
-
-  /* If the free list is empty, create a new arena. */
-  if (list_empty (&d->free_list))
-    {
-      size_t i;
-
-      /* Allocate a page. */
-      a = palloc_get_page (0);
-      if (a == NULL) 
-        {
-          lock_release (&d->lock);
-          return NULL; 
-        }
-
-      /* Initialize arena and add its blocks to the free list. */
-      a->magic = ARENA_MAGIC;
-      a->desc = d;
-      a->free_cnt = d->blocks_per_arena;
-      for (i = 0; i < d->blocks_per_arena; i++) 
-        {
-          struct block *b = arena_to_block (a, i);
-          list_push_back (&d->free_list, &b->free_elem);
-        }
-    }
-
-  /* Get a block from free list and return it. */
-  b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
-  a = block_to_arena (b);
-  a->free_cnt--;
-  lock_release (&d->lock);
-  return b;
+  /* Take a block from the current thread's magazine, loading
+     it first if it is empty. */
+  ASSERT (!intr_context ());
+  m = &thread_current ()->magazines[d - descs];
+  if (m->cnt == 0 && !magazine_load (d, m))
+    return NULL;
+  mb = m->head;
+  m->head = mb->next;
+  m->cnt--;
+
+  *block_to_info (block_to_arena ((struct block *) mb), (struct block *) mb)
+    = (tag << INFO_TAG_SHIFT) | size;
+  account (d, tag, size, d->block_size, 1);
+  return mb;
 }
 
-/* Allocates and return A times B bytes initialized to zeroes.
+/* Allocates and return A times B bytes initialized to zeroes,
+   charging them to TAG.
    Returns a null pointer if memory is not available. */
 void *
-calloc (size_t a, size_t b) 
+calloc_tagged (size_t a, size_t b, enum mem_tag tag) 
 {
   void *p;
   size_t size;
@@ -167,7 +246,7 @@ calloc (size_t a, size_t b)
     return NULL;
 
   /* Allocate and zero memory. */
-  p = malloc (size);
+  p = malloc_tagged (size, tag);
   if (p != NULL)
     memset (p, 0, size);
 
@@ -186,13 +265,13 @@ block_size (void *block)
 }
 
 /* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly
-   moving it in the process.
+   moving it in the process, and charges the new block to TAG.
    If successful, returns the new block; on failure, returns a
    null pointer.
    A call with null OLD_BLOCK is equivalent to malloc(NEW_SIZE).
    A call with zero NEW_SIZE is equivalent to free(OLD_BLOCK). */
 void *
-realloc (void *old_block, size_t new_size) 
+realloc_tagged (void *old_block, size_t new_size, enum mem_tag tag) 
 {
   if (new_size == 0) 
     {
@@ -201,7 +280,7 @@ realloc (void *old_block, size_t new_size)
     }
   else 
     {
-      void *new_block = malloc (new_size);
+      void *new_block = malloc_tagged (new_size, tag);
       if (old_block != NULL && new_block != NULL)
         {
           size_t old_size = block_size (old_block);
@@ -223,46 +302,267 @@ free (void *p)
       struct block *b = p;
       struct arena *a = block_to_arena (b);
       struct desc *d = a->desc;
+      struct malloc_magazine *m;
+      struct mag_block *mb;
       
       if (d != NULL) 
         {
           /* It's a normal block.  We handle it here. */
+          block_info info = *block_to_info (a, b);
+
+          account (d, info >> INFO_TAG_SHIFT, info & INFO_SIZE_MASK,
+                   d->block_size, -1);
 
 #ifndef NDEBUG
           /* Clear the block to help detect use-after-free bugs. */
           memset (b, 0xcc, d->block_size);
 #endif
   
-          lock_acquire (&d->lock);
-
-          /* Add block to free list. */
-          list_push_front (&d->free_list, &b->free_elem);
-
-          /* If the arena is now entirely unused, free it. */
-          if (++a->free_cnt >= d->blocks_per_arena) 
-            {
-              size_t i;
-
-              ASSERT (a->free_cnt == d->blocks_per_arena);
-              for (i = 0; i < d->blocks_per_arena; i++) 
-                {
-                  struct block *b = arena_to_block (a, i);
-                  list_remove (&b->free_elem);
-                }
-              palloc_free_page (a);
-            }
-
-          lock_release (&d->lock);
+          /* Put the block in the current thread's magazine,
+             first unloading a batch if it is full. */
+          ASSERT (!intr_context ());
+          m = &thread_current ()->magazines[d - descs];
+          if (m->cnt >= 2 * d->mag_rounds)
+            magazine_unload (d, m);
+          mb = p;
+          mb->next = m->head;
+          m->head = mb;
+          m->cnt++;
         }
       else
         {
           /* It's a big block.  Free its pages. */
+          account (NULL, a->big_tag, a->big_size, a->free_cnt * PGSIZE, -1);
           palloc_free_multiple (a, a->free_cnt);
           return;
         }
     }
 }
 
+/* Returns the current thread's magazines to the arenas.  Called
+   by thread_exit(). */
+void
+malloc_thread_exit (void) 
+{
+  struct thread *t = thread_current ();
+  size_t i;
+
+  for (i = 0; i < desc_cnt; i++) 
+    {
+      struct desc *d = &descs[i];
+      struct malloc_magazine *m = &t->magazines[i];
+
+      /* Only this thread touches its magazines, so an empty one
+         can be skipped without taking the lock. */
+      if (m->head == NULL)
+        continue;
+
+      lock_acquire (&d->lock);
+      while (m->head != NULL) 
+        {
+          struct mag_block *mb = m->head;
+          m->head = mb->next;
+          arena_free_block (d, (struct block *) mb);
+        }
+      m->cnt = 0;
+      lock_release (&d->lock);
+    }
+}
+
+/* Fills empty magazine M with a batch of D's blocks, from D's
+   depot if possible, otherwise from its arenas.  Returns true if
+   at least one block was loaded, false if memory is not
+   available. */
+static bool
+magazine_load (struct desc *d, struct malloc_magazine *m) 
+{
+  ASSERT (m->cnt == 0);
+
+  lock_acquire (&d->lock);
+  if (d->depot != NULL) 
+    {
+      m->head = d->depot;
+      m->cnt = d->mag_rounds;
+      d->depot = d->depot->next_batch;
+      d->depot_cnt--;
+    }
+  else 
+    {
+      while (m->cnt < d->mag_rounds) 
+        {
+          struct mag_block *mb = (struct mag_block *) arena_alloc_block (d);
+          if (mb == NULL)
+            break;
+          mb->next = m->head;
+          m->head = mb;
+          m->cnt++;
+        }
+    }
+  lock_release (&d->lock);
+
+  return m->cnt > 0;
+}
+
+/* Moves a batch of blocks from the front of magazine M to D's
+   depot, or back to D's arenas if the depot is full. */
+static void
+magazine_unload (struct desc *d, struct malloc_magazine *m) 
+{
+  struct mag_block *batch = m->head, *last = batch;
+  size_t i;
+
+  /* Split off the batch. */
+  for (i = 1; i < d->mag_rounds; i++)
+    last = last->next;
+  m->head = last->next;
+  m->cnt -= d->mag_rounds;
+  last->next = NULL;
+
+  lock_acquire (&d->lock);
+  if (d->depot_cnt < DEPOT_MAX) 
+    {
+      batch->next_batch = d->depot;
+      d->depot = batch;
+      d->depot_cnt++;
+    }
+  else
+    while (batch != NULL) 
+      {
+        struct mag_block *mb = batch;
+        batch = mb->next;
+        arena_free_block (d, (struct block *) mb);
+      }
+  lock_release (&d->lock);
+}
+
+/* Removes a block from D's free list, creating a new arena if
+   the list is empty, and returns it.  Returns a null pointer if
+   memory is not available.  D's lock must be held. */
+static struct block *
+arena_alloc_block (struct desc *d) 
+{
+  struct block *b;
+  struct arena *a;
+
+  /* If the free list is empty, create a new arena. */
+  if (list_empty (&d->free_list))
+    {
+      size_t i;
+
+      /* Allocate a page. */
+      a = palloc_get_multiple_tagged (0, 1, MEM_TAG_MALLOC);
+      if (a == NULL) 
+        return NULL; 
+
+      /* Initialize arena and add its blocks to the free list. */
+      a->magic = ARENA_MAGIC;
+      a->desc = d;
+      a->free_cnt = d->blocks_per_arena;
+      for (i = 0; i < d->blocks_per_arena; i++) 
+        {
+          struct block *b = arena_to_block (a, i);
+          list_push_back (&d->free_list, &b->free_elem);
+        }
+      d->arena_cnt++;
+      d->free_blocks += d->blocks_per_arena;
+    }
+
+  /* Get a block from free list and return it. */
+  b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
+  a = block_to_arena (b);
+  a->free_cnt--;
+  d->free_blocks--;
+  return b;
+}
+
+/* Adds block B to D's free list, giving its arena back to the
+   page allocator if the arena is now entirely unused.  D's lock
+   must be held. */
+static void
+arena_free_block (struct desc *d, struct block *b) 
+{
+  struct arena *a = block_to_arena (b);
+
+  /* Add block to free list. */
+  list_push_front (&d->free_list, &b->free_elem);
+  d->free_blocks++;
+
+  /* If the arena is now entirely unused, free it. */
+  if (++a->free_cnt >= d->blocks_per_arena) 
+    {
+      size_t i;
+
+      ASSERT (a->free_cnt == d->blocks_per_arena);
+      for (i = 0; i < d->blocks_per_arena; i++) 
+        {
+          struct block *b = arena_to_block (a, i);
+          list_remove (&b->free_elem);
+        }
+      palloc_free_page (a);
+      d->arena_cnt--;
+      d->free_blocks -= d->blocks_per_arena;
+    }
+}
+
+/* Returns the block_info entry for block B in arena A. */
+static block_info *
+block_to_info (struct arena *a, struct block *b) 
+{
+  size_t idx = (pg_ofs (b) - a->desc->first_ofs) / a->desc->block_size;
+  return (block_info *) (a + 1) + idx;
+}
+
+/* Adds (if SIGN is 1) or removes (if SIGN is -1) a block of
+   SIZE requested bytes, occupying ALLOCATED bytes, to or from
+   the statistics for descriptor D, if nonnull, and for TAG. */
+static void
+account (struct desc *d, enum mem_tag tag, size_t size, size_t allocated,
+         int sign) 
+{
+  struct memstat_tag *t = &heap_tags[tag];
+
+  if (d != NULL) 
+    {
+      __sync_fetch_and_add (&d->in_use, sign);
+      __sync_fetch_and_add (&d->requested, sign * size);
+    }
+  __sync_fetch_and_add (&t->heap_blocks, sign);
+  __sync_fetch_and_add (&t->heap_requested, sign * size);
+  __sync_fetch_and_add (&t->heap_allocated, sign * allocated);
+}
+
+/* Stores statistics for each size class into CLASSES and adds
+   the heap usage of each subsystem to TAGS. */
+void
+malloc_get_stats (struct memstat_class classes[MALLOC_CLASS_CNT],
+                  struct memstat_tag tags[MEM_TAG_CNT]) 
+{
+  size_t i;
+
+  for (i = 0; i < desc_cnt; i++) 
+    {
+      struct desc *d = &descs[i];
+      struct memstat_class *c = &classes[i];
+      size_t taken;
+
+      lock_acquire (&d->lock);
+      c->block_size = d->block_size;
+      c->arena_cnt = d->arena_cnt;
+      c->in_use = d->in_use;
+      c->requested = d->requested;
+      taken = d->arena_cnt * d->blocks_per_arena - d->free_blocks;
+      c->cached = taken > c->in_use ? taken - c->in_use : 0;
+      lock_release (&d->lock);
+    }
+
+  for (i = 0; i < MEM_TAG_CNT; i++) 
+    {
+      tags[i].heap_blocks += heap_tags[i].heap_blocks;
+      tags[i].heap_requested += heap_tags[i].heap_requested;
+      tags[i].heap_allocated += heap_tags[i].heap_allocated;
+    }
+}
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b)
@@ -275,7 +575,8 @@ block_to_arena (struct block *b)
 
   /* Check that the block is properly aligned for the arena. */
   ASSERT (a->desc == NULL
-          || (pg_ofs (b) - sizeof *a) % a->desc->block_size == 0);
+          || ((pg_ofs (b) - a->desc->first_ofs)
+              % a->desc->block_size == 0));
   ASSERT (a->desc != NULL || pg_ofs (b) == sizeof *a);
 
   return a;
@@ -289,6 +590,6 @@ arena_to_block (struct arena *a, size_t idx)
   ASSERT (a->magic == ARENA_MAGIC);
   ASSERT (idx < a->desc->blocks_per_arena);
   return (struct block *) ((uint8_t *) a
-                           + sizeof *a
+                           + a->desc->first_ofs
                            + idx * a->desc->block_size);
 }
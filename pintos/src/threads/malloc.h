@@ -3,11 +3,32 @@
 
 #include <debug.h>
 #include <stddef.h>
+#include "threads/memstat.h"
+
+/* Number of size classes served from arenas: blocks of 16, 32,
+   ..., 1,024 bytes.  Larger requests get whole pages. */
+#define MALLOC_CLASS_CNT MEMSTAT_CLASS_CNT
+
+/* A thread's stash of free blocks of one size class, which
+   malloc() and free() use without locking.  See malloc.c. */
+struct malloc_magazine
+  {
+    void *head;                 /* First block, or null. */
+    size_t cnt;                 /* Number of blocks. */
+  };
 
 void malloc_init (void);
-void *malloc (size_t) __attribute__ ((malloc));
-void *calloc (size_t, size_t) __attribute__ ((malloc));
-void *realloc (void *, size_t);
+void *malloc_tagged (size_t, enum mem_tag) __attribute__ ((malloc));
+void *calloc_tagged (size_t, size_t, enum mem_tag) __attribute__ ((malloc));
+void *realloc_tagged (void *, size_t, enum mem_tag);
 void free (void *);
+void malloc_thread_exit (void);
+void malloc_get_stats (struct memstat_class[MALLOC_CLASS_CNT],
+                       struct memstat_tag[MEM_TAG_CNT]);
+
+/* Allocate on behalf of the caller's subsystem. */
+#define malloc(SIZE) malloc_tagged (SIZE, MEM_TAG)
+#define calloc(A, B) calloc_tagged (A, B, MEM_TAG)
+#define realloc(BLOCK, SIZE) realloc_tagged (BLOCK, SIZE, MEM_TAG)
 
 #endif /* threads/malloc.h */
@@ -0,0 +1,95 @@
+#include "threads/memstat.h"
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+
+/* Names of the subsystems in enum mem_tag, for reports. */
+static const char *tag_names[MEM_TAG_CNT] =
+  {"other", "threads", "userprog", "vm", "filesys", "malloc"};
+
+static void get_pool (enum palloc_flags, struct memstat_pool *,
+                      struct memstat_tag[MEM_TAG_CNT]);
+static void print_pool (const char *name, const struct memstat_pool *);
+
+/* Stores a snapshot of kernel memory statistics into *MS. */
+void
+memstat_get (struct memstat *ms) 
+{
+  memset (ms, 0, sizeof *ms);
+  get_pool (0, &ms->kernel_pool, ms->tags);
+  get_pool (PAL_USER, &ms->user_pool, ms->tags);
+  malloc_get_stats (ms->classes, ms->tags);
+}
+
+/* Prints kernel memory statistics: page pool usage, malloc()
+   size classes with their internal fragmentation, and the
+   memory charged to each subsystem. */
+void
+memstat_print (void) 
+{
+  struct memstat ms;
+  int i;
+
+  memstat_get (&ms);
+  print_pool ("Kernel", &ms.kernel_pool);
+  print_pool ("User", &ms.user_pool);
+
+  for (i = 0; i < MEMSTAT_CLASS_CNT; i++) 
+    {
+      const struct memstat_class *c = &ms.classes[i];
+      size_t allocated = c->in_use * c->block_size;
+
+      if (c->arena_cnt == 0)
+        continue;
+      printf ("malloc %zu-byte blocks: %zu in use, %zu cached, "
+              "%zu arenas, %zu%% internal fragmentation\n",
+              c->block_size, c->in_use, c->cached, c->arena_cnt,
+              allocated > 0
+              ? (allocated - c->requested) * 100 / allocated : 0);
+    }
+
+  for (i = 0; i < MEM_TAG_CNT; i++) 
+    {
+      const struct memstat_tag *t = &ms.tags[i];
+
+      if (t->pages == 0 && t->heap_blocks == 0)
+        continue;
+      printf ("Memory for %s: %zu pages, %zu heap blocks "
+              "(%zu bytes requested, %zu allocated)\n",
+              tag_names[i], t->pages, t->heap_blocks,
+              t->heap_requested, t->heap_allocated);
+    }
+}
+
+/* Stores statistics for the pool selected by FLAGS into *POOL
+   and adds its pages to the counts in TAGS. */
+static void
+get_pool (enum palloc_flags flags, struct memstat_pool *pool,
+          struct memstat_tag tags[MEM_TAG_CNT]) 
+{
+  struct palloc_stats stats;
+  int i;
+
+  palloc_get_stats (flags, &stats);
+  pool->page_cnt = stats.page_cnt;
+  pool->free_cnt = stats.free_cnt;
+  pool->largest_free = stats.largest_free;
+  pool->zeroed_cnt = stats.zeroed_cnt;
+  pool->zero_hits = stats.zero_hits;
+  pool->zero_misses = stats.zero_misses;
+  for (i = 0; i < MEM_TAG_CNT; i++)
+    tags[i].pages += stats.tag_pages[i];
+}
+
+/* Prints the statistics in POOL for the pool called NAME. */
+static void
+print_pool (const char *name, const struct memstat_pool *pool) 
+{
+  printf ("%s pool: %zu of %zu pages free, largest free block "
+          "%zu pages\n", name, pool->free_cnt, pool->page_cnt,
+          pool->largest_free);
+  printf ("%s pool: %zu pages pre-zeroed, %zu zeroed requests "
+          "served from them, %zu zeroed inline\n", name, pool->zeroed_cnt,
+          pool->zero_hits, pool->zero_misses);
+}
@@ -0,0 +1,20 @@
+#ifndef THREADS_MEMSTAT_H
+#define THREADS_MEMSTAT_H
+
+#include <memstat.h>
+
+/* Kernel memory accounting.
+
+   Page and heap allocations are charged to the subsystem that
+   makes them.  palloc_get_page(), malloc(), and friends are
+   macros that pass MEM_TAG, which Makefile.build defines for
+   each kernel source directory, so callers need not name their
+   subsystem themselves. */
+#ifndef MEM_TAG
+#define MEM_TAG MEM_TAG_OTHER
+#endif
+
+void memstat_get (struct memstat *);
+void memstat_print (void);
+
+#endif /* threads/memstat.h */
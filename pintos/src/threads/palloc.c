@@ -2,14 +2,17 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/loader.h"
-#include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "threads/workqueue.h"
 
 /* Page allocator.  Hands out memory in page-size (or
    page-multiple) chunks.  See malloc.h for an allocator that
@@ -28,17 +31,94 @@
 /* A memory pool. */
 struct pool
   {
-    struct lock lock;                   /* Mutual exclusion. */
     struct bitmap *used_map;            /* Bitmap of free pages. */
     uint8_t *base;                      /* Base of pool. */
+    uint8_t *free_order;                /* Per page: order of the free
+                                           block it starts, or NOT_FREE. */
+    uint8_t *tags;                      /* Per page: enum mem_tag charged
+                                           for it, if allocated. */
+    size_t tag_pages[MEM_TAG_CNT];      /* Allocated pages, by tag. */
+    struct list free_lists[PALLOC_ORDERS]; /* Free blocks, by order. */
+    size_t free_cnt;                    /* Number of free pages. */
+
+    /* Pre-zeroed pages, see zero_pages(). */
+    void *zeroed;                       /* Stack of zeroed pages. */
+    size_t zeroed_cnt;                  /* Pages on the stack. */
+    size_t zeroed_max;                  /* Most pages to keep there. */
+    size_t zero_hits;                   /* PAL_ZERO pages from the stack. */
+    size_t zero_misses;                 /* PAL_ZERO pages zeroed inline. */
+    struct work zero_work;              /* Refills the stack. */
   };
 
+/* Pages are managed with a binary buddy allocator.  A block of
+   order K is 2**K pages long and starts at a page index, counted
+   from the pool base, that is a multiple of 2**K.  Its buddy is
+   the block of the same order whose index differs only in bit K;
+   a freed block is merged with its buddy whenever the buddy is
+   free too, and the result with its own buddy, and so on.
+
+   A request for N pages takes a block of the smallest order that
+   fits, splitting a larger block if need be, and returns the
+   pages past N to the free lists, so no memory is lost to
+   rounding.  Likewise, freeing N pages frees them as the largest
+   aligned blocks that make them up.  Allocation and freeing
+   therefore take time logarithmic in the pool size instead of
+   the linear bitmap scan used before.
+
+   Free blocks are linked into the free lists through a list_elem
+   at their start.  Pools are protected by turning interrupts
+   off, so pages may be freed from any context, even while a
+   dying thread's page is freed in schedule(). */
+
+/* free_order value for pages that do not start a free block. */
+#define NOT_FREE 0xff
+
+/* Single-page PAL_ZERO requests, which include every stack, BSS
+   and page table page, are served from a stack of pages that a
+   worker thread zeroes ahead of time, so that the zeroing
+   happens off the page fault path.  The worker has the lowest
+   claim on the CPU that each scheduler offers: PRI_MIN under
+   the priority scheduler, where it runs only when nothing else
+   is ready, and NICE_MAX under -mlfqs and -cfs, which ignore
+   the priority it was created with.  Under those two it still
+   gets a small share of the CPU while other threads are busy.
+   Pages on the stack are linked through their first word, which
+   is cleared again when the page is handed out.  They count as
+   free in statistics and are given back to the buddy allocator
+   whenever a request would otherwise fail.
+
+   Each pool keeps at most ZEROED_MAX pages, or 1/64 of its
+   pages if that is fewer, and the worker stops refilling while
+   fewer pages than that remain free otherwise. */
+#define ZEROED_MAX 64
+
 /* Two pools: one for kernel data, one for user pages. */
 static struct pool kernel_pool, user_pool;
 
+/* Runs zero_pages() at PRI_MIN and NICE_MAX. */
+static struct workqueue zero_wq;
+static bool zero_wq_started;
+
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static size_t alloc_block (struct pool *, unsigned order);
+static void free_block (struct pool *, size_t page_idx, unsigned order);
+static void free_range (struct pool *, size_t page_idx, size_t page_cnt);
+static void *pop_zeroed (struct pool *);
+static void release_zeroed (struct pool *);
+static void zero_pages (void *pool);
+
+/* Returns the smallest order whose blocks hold PAGE_CNT pages. */
+static unsigned
+order_for (size_t page_cnt) 
+{
+  unsigned order = 0;
+
+  while (((size_t) 1 << order) < page_cnt)
+    order++;
+  return order;
+}
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -61,25 +141,86 @@ palloc_init (size_t user_page_limit)
              user_pages, "user pool");
 }
 
-/* Obtains and returns a group of PAGE_CNT contiguous free pages.
+/* Starts the thread that keeps a stack of pre-zeroed pages in
+   each pool.  Must be called after workqueue_init(); until then,
+   PAL_ZERO pages are always zeroed inline. */
+void
+palloc_start_zeroing (void) 
+{
+  if (!workqueue_create (&zero_wq, "pagezero", 1, PRI_MIN))
+    PANIC ("palloc_start_zeroing: cannot create worker thread");
+  zero_wq_started = true;
+  queue_work (&zero_wq, &kernel_pool.zero_work);
+  queue_work (&zero_wq, &user_pool.zero_work);
+}
+
+/* Obtains and returns a group of PAGE_CNT contiguous free pages,
+   charging them to TAG.  Most callers use palloc_get_page() or
+   palloc_get_multiple(), which charge the caller's subsystem.
    If PAL_USER is set, the pages are obtained from the user pool,
    otherwise from the kernel pool.  If PAL_ZERO is set in FLAGS,
    then the pages are filled with zeros.  If too few pages are
    available, returns a null pointer, unless PAL_ASSERT is set in
    FLAGS, in which case the kernel panics. */
 void *
-palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
+palloc_get_multiple_tagged (enum palloc_flags flags, size_t page_cnt,
+                            enum mem_tag tag)
 {
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  enum intr_level old_level;
   void *pages;
-  size_t page_idx;
+  unsigned order;
+  size_t page_idx = BITMAP_ERROR;
+  bool zeroed = false;
+  bool refill = false;
 
   if (page_cnt == 0)
     return NULL;
 
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
+  order = order_for (page_cnt);
+  if (order < PALLOC_ORDERS) 
+    {
+      old_level = intr_disable ();
+      if ((flags & PAL_ZERO) && page_cnt == 1) 
+        {
+          void *page = pop_zeroed (pool);
+
+          if (page != NULL) 
+            {
+              zeroed = true;
+              page_idx = pg_no (page) - pg_no (pool->base);
+              pool->zero_hits++;
+            }
+          else
+            pool->zero_misses++;
+          refill = pool->zeroed_cnt < pool->zeroed_max / 2;
+        }
+      if (page_idx == BITMAP_ERROR) 
+        {
+          page_idx = alloc_block (pool, order);
+          if (page_idx == BITMAP_ERROR && pool->zeroed_cnt > 0) 
+            {
+              release_zeroed (pool);
+              page_idx = alloc_block (pool, order);
+            }
+          if (page_idx != BITMAP_ERROR) 
+            {
+              free_range (pool, page_idx + page_cnt,
+                          ((size_t) 1 << order) - page_cnt);
+              pool->free_cnt -= page_cnt;
+              bitmap_set_multiple (pool->used_map, page_idx, page_cnt,
+                                   true);
+            }
+        }
+      if (page_idx != BITMAP_ERROR) 
+        {
+          memset (pool->tags + page_idx, tag, page_cnt);
+          pool->tag_pages[tag] += page_cnt;
+        }
+      if (refill && zero_wq_started)
+        queue_work (&zero_wq, &pool->zero_work);
+      intr_set_level (old_level);
+    }
 
   if (page_idx != BITMAP_ERROR)
     pages = pool->base + PGSIZE * page_idx;
@@ -88,7 +229,9 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 
   if (pages != NULL) 
     {
-      if (flags & PAL_ZERO)
+      if (zeroed)
+        *(void **) pages = NULL;
+      else if (flags & PAL_ZERO)
         memset (pages, 0, PGSIZE * page_cnt);
     }
   else 
@@ -100,25 +243,13 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
   return pages;
 }
 
-/* Obtains a single free page and returns its kernel virtual
-   address.
-   If PAL_USER is set, the page is obtained from the user pool,
-   otherwise from the kernel pool.  If PAL_ZERO is set in FLAGS,
-   then the page is filled with zeros.  If no pages are
-   available, returns a null pointer, unless PAL_ASSERT is set in
-   FLAGS, in which case the kernel panics. */
-void *
-palloc_get_page (enum palloc_flags flags) 
-{
-  return palloc_get_multiple (flags, 1);
-}
-
 /* Frees the PAGE_CNT pages starting at PAGES. */
 void
 palloc_free_multiple (void *pages, size_t page_cnt) 
 {
   struct pool *pool;
-  size_t page_idx;
+  enum intr_level old_level;
+  size_t page_idx, i;
 
   ASSERT (pg_ofs (pages) == 0);
   if (pages == NULL || page_cnt == 0)
@@ -137,8 +268,14 @@ palloc_free_multiple (void *pages, size_t page_cnt)
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
+  old_level = intr_disable ();
   ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
   bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  for (i = page_idx; i < page_idx + page_cnt; i++)
+    pool->tag_pages[pool->tags[i]]--;
+  free_range (pool, page_idx, page_cnt);
+  pool->free_cnt += page_cnt;
+  intr_set_level (old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -148,25 +285,88 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Stores statistics about the pool selected by FLAGS, as for
+   palloc_get_multiple(), into *STATS. */
+void
+palloc_get_stats (enum palloc_flags flags, struct palloc_stats *stats) 
+{
+  struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  enum intr_level old_level;
+  int order;
+
+  old_level = intr_disable ();
+  stats->page_cnt = bitmap_size (pool->used_map);
+  stats->free_cnt = pool->free_cnt + pool->zeroed_cnt;
+  stats->zeroed_cnt = pool->zeroed_cnt;
+  stats->zero_hits = pool->zero_hits;
+  stats->zero_misses = pool->zero_misses;
+  stats->largest_free = 0;
+  memcpy (stats->tag_pages, pool->tag_pages, sizeof stats->tag_pages);
+  for (order = PALLOC_ORDERS - 1; order >= 0; order--)
+    if (!list_empty (&pool->free_lists[order])) 
+      {
+        stats->largest_free = (size_t) 1 << order;
+        break;
+      }
+  intr_set_level (old_level);
+}
+
+/* Returns the number of free pages in the pool selected by
+   FLAGS, as for palloc_get_multiple().  The count is read without
+   locking, so it may be slightly stale; it is meant for cheap
+   checks against thresholds. */
+size_t
+palloc_free_cnt (enum palloc_flags flags) 
+{
+  struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+
+  return pool->free_cnt + pool->zeroed_cnt;
+}
+
+/* Stores the address of the first page in the user pool into
+   *BASE and the number of pages in it into *PAGE_CNT, so that
+   callers can keep per-frame data for user pages. */
+void
+palloc_get_user_range (void **base, size_t *page_cnt) 
+{
+  *base = user_pool.base;
+  *page_cnt = bitmap_size (user_pool.used_map);
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
-     and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
-  if (bm_pages > page_cnt)
+  /* We'll put the pool's used_map, free_order, and tags at its
+     base.  Calculate the space needed for them and subtract it
+     from the pool's size. */
+  size_t bm_size = bitmap_buf_size (page_cnt);
+  size_t meta_pages = DIV_ROUND_UP (bm_size + 2 * page_cnt, PGSIZE);
+  size_t i;
+  if (meta_pages > page_cnt)
     PANIC ("Not enough memory in %s for bitmap.", name);
-  page_cnt -= bm_pages;
+  page_cnt -= meta_pages;
 
   printf ("%zu pages available in %s.\n", page_cnt, name);
 
   /* Initialize the pool. */
-  lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
-  p->base = base + bm_pages * PGSIZE;
+  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_size);
+  p->free_order = (uint8_t *) base + bm_size;
+  memset (p->free_order, NOT_FREE, page_cnt);
+  p->tags = p->free_order + page_cnt;
+  memset (p->tag_pages, 0, sizeof p->tag_pages);
+  p->base = base + meta_pages * PGSIZE;
+  for (i = 0; i < PALLOC_ORDERS; i++)
+    list_init (&p->free_lists[i]);
+  free_range (p, 0, page_cnt);
+  p->free_cnt = page_cnt;
+
+  p->zeroed = NULL;
+  p->zeroed_cnt = 0;
+  p->zeroed_max = page_cnt / 64 < ZEROED_MAX ? page_cnt / 64 : ZEROED_MAX;
+  p->zero_hits = p->zero_misses = 0;
+  work_init (&p->zero_work, zero_pages, p);
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -180,3 +380,169 @@ page_from_pool (const struct pool *pool, void *page)
 
   return page_no >= start_page && page_no < end_page;
 }
+
+/* Returns the list element kept at the start of free page
+   PAGE_IDX in POOL. */
+static struct list_elem *
+free_elem (struct pool *pool, size_t page_idx) 
+{
+  return (struct list_elem *) (pool->base + PGSIZE * page_idx);
+}
+
+/* Removes a block of the given ORDER from POOL's free lists,
+   splitting a larger block if necessary, and returns the index
+   of its first page, or BITMAP_ERROR if no block is large
+   enough.  Interrupts must be off. */
+static size_t
+alloc_block (struct pool *pool, unsigned order) 
+{
+  unsigned cur;
+  size_t page_idx;
+
+  for (cur = order; cur < PALLOC_ORDERS; cur++)
+    if (!list_empty (&pool->free_lists[cur]))
+      break;
+  if (cur == PALLOC_ORDERS)
+    return BITMAP_ERROR;
+
+  page_idx = pg_no (list_pop_front (&pool->free_lists[cur]))
+             - pg_no (pool->base);
+  ASSERT (pool->free_order[page_idx] == cur);
+  pool->free_order[page_idx] = NOT_FREE;
+
+  /* Return the upper halves to the free lists until the block
+     has the requested size. */
+  while (cur > order) 
+    {
+      size_t buddy;
+
+      cur--;
+      buddy = page_idx + ((size_t) 1 << cur);
+      pool->free_order[buddy] = cur;
+      list_push_front (&pool->free_lists[cur], free_elem (pool, buddy));
+    }
+  return page_idx;
+}
+
+/* Returns the block of the given ORDER starting at page PAGE_IDX
+   to POOL, merging it with its free buddies.  Interrupts must
+   be off. */
+static void
+free_block (struct pool *pool, size_t page_idx, unsigned order) 
+{
+  size_t page_cnt = bitmap_size (pool->used_map);
+
+  while (order + 1 < PALLOC_ORDERS) 
+    {
+      size_t buddy = page_idx ^ ((size_t) 1 << order);
+
+      if (buddy + ((size_t) 1 << order) > page_cnt
+          || pool->free_order[buddy] != order)
+        break;
+      list_remove (free_elem (pool, buddy));
+      pool->free_order[buddy] = NOT_FREE;
+      if (buddy < page_idx)
+        page_idx = buddy;
+      order++;
+    }
+  pool->free_order[page_idx] = order;
+  list_push_front (&pool->free_lists[order], free_elem (pool, page_idx));
+}
+
+/* Frees the PAGE_CNT pages starting at PAGE_IDX in POOL as the
+   largest aligned blocks that make them up.  Interrupts must be
+   off, except during initialization. */
+static void
+free_range (struct pool *pool, size_t page_idx, size_t page_cnt) 
+{
+  while (page_cnt > 0) 
+    {
+      unsigned order = 0;
+
+      while (order + 1 < PALLOC_ORDERS
+             && page_idx % ((size_t) 2 << order) == 0
+             && ((size_t) 2 << order) <= page_cnt)
+        order++;
+      free_block (pool, page_idx, order);
+      page_idx += (size_t) 1 << order;
+      page_cnt -= (size_t) 1 << order;
+    }
+}
+
+/* Pops a page off POOL's stack of zeroed pages and returns it,
+   or returns a null pointer if the stack is empty.  The page's
+   first word still holds the stack link.  Interrupts must be
+   off. */
+static void *
+pop_zeroed (struct pool *pool) 
+{
+  void *page = pool->zeroed;
+
+  if (page != NULL) 
+    {
+      pool->zeroed = *(void **) page;
+      pool->zeroed_cnt--;
+    }
+  return page;
+}
+
+/* Returns all of POOL's zeroed pages to the buddy allocator.
+   Interrupts must be off. */
+static void
+release_zeroed (struct pool *pool) 
+{
+  void *page;
+
+  while ((page = pop_zeroed (pool)) != NULL) 
+    {
+      size_t page_idx = pg_no (page) - pg_no (pool->base);
+
+      bitmap_reset (pool->used_map, page_idx);
+      free_block (pool, page_idx, 0);
+      pool->free_cnt++;
+    }
+}
+
+/* Work function that fills POOL_'s stack of zeroed pages.  Runs
+   in the "pagezero" worker, see the comment on ZEROED_MAX. */
+static void
+zero_pages (void *pool_) 
+{
+  struct pool *pool = pool_;
+
+  /* -mlfqs and -cfs schedule by nice, not by the PRI_MIN the
+     worker was created with. */
+  if ((thread_mlfqs || thread_cfs) && thread_get_nice () != NICE_MAX)
+    thread_set_nice (NICE_MAX);
+
+  for (;;) 
+    {
+      enum intr_level old_level;
+      size_t page_idx = BITMAP_ERROR;
+      void *page;
+
+      old_level = intr_disable ();
+      if (pool->zeroed_cnt < pool->zeroed_max
+          && pool->free_cnt > pool->zeroed_max) 
+        {
+          page_idx = alloc_block (pool, 0);
+          if (page_idx != BITMAP_ERROR) 
+            {
+              pool->free_cnt--;
+              bitmap_mark (pool->used_map, page_idx);
+            }
+        }
+      intr_set_level (old_level);
+      if (page_idx == BITMAP_ERROR)
+        break;
+
+      page = pool->base + PGSIZE * page_idx;
+      memset (page, 0, PGSIZE);
+
+      old_level = intr_disable ();
+      *(void **) page = pool->zeroed;
+      pool->zeroed = page;
+      pool->zeroed_cnt++;
+      intr_set_level (old_level);
+    }
+}
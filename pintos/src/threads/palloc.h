@@ -2,6 +2,7 @@
 #define THREADS_PALLOC_H
 
 #include <stddef.h>
+#include "threads/memstat.h"
 
 /* How to allocate pages. */
 enum palloc_flags
@@ -11,10 +12,37 @@ enum palloc_flags
     PAL_USER = 004              /* User page. */
   };
 
+/* Number of block sizes managed by the buddy allocator: blocks
+   of 1, 2, 4, ..., 2**(PALLOC_ORDERS - 1) pages.  No single
+   request may exceed the largest. */
+#define PALLOC_ORDERS 16
+
+/* Pool statistics, from palloc_get_stats(). */
+struct palloc_stats
+  {
+    size_t page_cnt;            /* Pages in the pool. */
+    size_t free_cnt;            /* Free pages. */
+    size_t largest_free;        /* Pages in the largest free block. */
+    size_t zeroed_cnt;          /* Free pages already zeroed. */
+    size_t zero_hits;           /* PAL_ZERO pages taken pre-zeroed. */
+    size_t zero_misses;         /* PAL_ZERO pages zeroed on request. */
+    size_t tag_pages[MEM_TAG_CNT]; /* Pages allocated, by subsystem. */
+  };
+
 void palloc_init (size_t user_page_limit);
-void *palloc_get_page (enum palloc_flags);
-void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
+void palloc_start_zeroing (void);
+void *palloc_get_multiple_tagged (enum palloc_flags, size_t page_cnt,
+                                  enum mem_tag);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+void palloc_get_stats (enum palloc_flags, struct palloc_stats *);
+size_t palloc_free_cnt (enum palloc_flags);
+void palloc_get_user_range (void **base, size_t *page_cnt);
+
+/* Allocate pages on behalf of the caller's subsystem. */
+#define palloc_get_page(FLAGS) \
+        palloc_get_multiple_tagged (FLAGS, 1, MEM_TAG)
+#define palloc_get_multiple(FLAGS, PAGE_CNT) \
+        palloc_get_multiple_tagged (FLAGS, PAGE_CNT, MEM_TAG)
 
 #endif /* threads/palloc.h */
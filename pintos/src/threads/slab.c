@@ -0,0 +1,314 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Object caches.
+
+   Each cache owns a set of slabs, one page each.  A slab starts
+   with a struct slab header, followed by as many fixed-size
+   slots as fit in the rest of the page.  The free slots of a
+   slab are chained through a link pointer kept in each slot,
+   so allocating or freeing an object is a few pointer moves
+   under the cache's lock.
+
+   A cache keeps its slabs on two lists: "partial" for slabs
+   with at least one free slot, from which objects are
+   allocated, and "full" for slabs with none.  When the last
+   object in a slab is freed, the slab is reclaimed: its page
+   goes back to the page allocator, except that one empty slab
+   per cache is held in reserve so that a cache that oscillates
+   around a slab boundary does not fetch and release a page on
+   every call.  kmem_cache_shrink() releases that one too.
+
+   If a cache has a constructor, it is run once on each object
+   when its slab is created, not on every allocation, and
+   objects must be freed in their constructed state.  The free
+   link then goes after the object rather than over its first
+   bytes, so that the constructed state survives. */
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* Slab header, at the start of each slab's page. */
+struct slab 
+  {
+    unsigned magic;             /* Always set to SLAB_MAGIC. */
+    struct kmem_cache *cache;   /* Owning cache. */
+    struct list_elem elem;      /* Element in cache's partial or full. */
+    size_t in_use;              /* Number of allocated objects. */
+    void *free;                 /* First free slot, or null. */
+  };
+
+/* All caches, for kmem_cache_print_stats().
+   Modified only with interrupts off. */
+static struct list all_caches = LIST_INITIALIZER (all_caches);
+
+static struct slab *new_slab (struct kmem_cache *);
+static void release_slab (struct kmem_cache *, struct slab *);
+static struct slab *obj_to_slab (struct kmem_cache *, void *);
+
+/* Returns the free link of slot OBJ in cache C. */
+static inline void **
+slot_link (const struct kmem_cache *c, void *obj) 
+{
+  return (void **) ((uint8_t *) obj + c->link_ofs);
+}
+
+/* Initializes C as a cache of SIZE-byte objects, aligned on
+   ALIGN-byte boundaries (which must be a power of 2, or 0 for
+   pointer alignment).  If CTOR is nonnull, it is called on each
+   object as its slab is created.  NAME is used for statistics
+   and must remain valid as long as the cache.  The cache's slabs
+   are charged to TAG; kmem_cache_init() charges the caller's
+   subsystem. */
+void
+kmem_cache_init_tagged (struct kmem_cache *c, const char *name, size_t size,
+                        size_t align, void (*ctor) (void *), enum mem_tag tag) 
+{
+  enum intr_level old_level;
+
+  ASSERT (size > 0);
+  ASSERT ((align & (align - 1)) == 0);
+
+  if (align < sizeof (void *))
+    align = sizeof (void *);
+  c->name = name;
+  c->obj_size = size;
+  c->link_ofs = ctor != NULL ? ROUND_UP (size, sizeof (void *)) : 0;
+  c->slot_size = c->link_ofs + sizeof (void *);
+  if (c->slot_size < size)
+    c->slot_size = size;
+  c->slot_size = ROUND_UP (c->slot_size, align);
+  c->first_ofs = ROUND_UP (sizeof (struct slab), align);
+  ASSERT (c->first_ofs + c->slot_size <= PGSIZE);
+  c->objs_per_slab = (PGSIZE - c->first_ofs) / c->slot_size;
+  c->ctor = ctor;
+  c->tag = tag;
+
+  lock_init (&c->lock);
+  list_init (&c->partial);
+  list_init (&c->full);
+  c->spare = NULL;
+  c->active = c->total = c->slab_cnt = 0;
+
+  old_level = intr_disable ();
+  list_push_back (&all_caches, &c->elem);
+  intr_set_level (old_level);
+}
+
+/* Obtains and returns a new object from cache C.
+   Returns a null pointer if memory is not available. */
+void *
+kmem_cache_alloc (struct kmem_cache *c) 
+{
+  struct slab *s;
+  void *obj;
+
+  lock_acquire (&c->lock);
+
+  /* Find a slab with a free slot, creating one if needed. */
+  if (list_empty (&c->partial)) 
+    {
+      if (c->spare != NULL) 
+        {
+          s = c->spare;
+          c->spare = NULL;
+        }
+      else 
+        {
+          s = new_slab (c);
+          if (s == NULL) 
+            {
+              lock_release (&c->lock);
+              return NULL;
+            }
+        }
+      list_push_front (&c->partial, &s->elem);
+    }
+  s = list_entry (list_front (&c->partial), struct slab, elem);
+
+  /* Take its first free slot. */
+  obj = s->free;
+  s->free = *slot_link (c, obj);
+  s->in_use++;
+  c->active++;
+  if (s->free == NULL) 
+    {
+      list_remove (&s->elem);
+      list_push_front (&c->full, &s->elem);
+    }
+
+  lock_release (&c->lock);
+  return obj;
+}
+
+/* Obtains and returns a new object from cache C, filled with
+   zeros.  C must not have a constructor.
+   Returns a null pointer if memory is not available. */
+void *
+kmem_cache_zalloc (struct kmem_cache *c) 
+{
+  void *obj;
+
+  ASSERT (c->ctor == NULL);
+  obj = kmem_cache_alloc (c);
+  if (obj != NULL)
+    memset (obj, 0, c->obj_size);
+  return obj;
+}
+
+/* Returns OBJ, which must have been allocated from cache C, to
+   C. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj) 
+{
+  struct slab *s;
+
+  if (obj == NULL)
+    return;
+  s = obj_to_slab (c, obj);
+
+#ifndef NDEBUG
+  /* Clear the object to help detect use-after-free bugs, unless
+     it is supposed to stay constructed. */
+  if (c->ctor == NULL)
+    memset (obj, 0xcc, c->obj_size);
+#endif
+
+  lock_acquire (&c->lock);
+  ASSERT (s->in_use > 0);
+
+  /* A full slab becomes partial again. */
+  if (s->free == NULL) 
+    {
+      list_remove (&s->elem);
+      list_push_front (&c->partial, &s->elem);
+    }
+  *slot_link (c, obj) = s->free;
+  s->free = obj;
+  s->in_use--;
+  c->active--;
+
+  /* Reclaim the slab if it is now empty. */
+  if (s->in_use == 0) 
+    {
+      list_remove (&s->elem);
+      if (c->spare == NULL)
+        c->spare = s;
+      else
+        release_slab (c, s);
+    }
+
+  lock_release (&c->lock);
+}
+
+/* Returns cache C's reserve empty slab, if any, to the page
+   allocator. */
+void
+kmem_cache_shrink (struct kmem_cache *c) 
+{
+  lock_acquire (&c->lock);
+  if (c->spare != NULL) 
+    {
+      release_slab (c, c->spare);
+      c->spare = NULL;
+    }
+  lock_release (&c->lock);
+}
+
+/* Stores statistics for cache C into *STATS. */
+void
+kmem_cache_get_stats (struct kmem_cache *c, struct kmem_cache_stats *stats) 
+{
+  lock_acquire (&c->lock);
+  stats->obj_size = c->obj_size;
+  stats->active = c->active;
+  stats->total = c->total;
+  stats->slab_cnt = c->slab_cnt;
+  lock_release (&c->lock);
+}
+
+/* Prints statistics for every cache.  Reads the counters
+   without locking, so that a kernel that panicked while holding
+   a cache's lock can still report on its way down. */
+void
+kmem_cache_print_stats (void) 
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&all_caches); e != list_end (&all_caches);
+       e = list_next (e)) 
+    {
+      struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+      printf ("Slab cache %s: %zu of %zu %zu-byte objects in use, "
+              "%zu slabs\n",
+              c->name, c->active, c->total, c->obj_size, c->slab_cnt);
+    }
+}
+
+/* Allocates a slab for cache C, which must be locked, and
+   chains its slots onto its free list.  Returns the new slab,
+   or a null pointer if no page is available. */
+static struct slab *
+new_slab (struct kmem_cache *c) 
+{
+  struct slab *s;
+  uint8_t *slot;
+  size_t i;
+
+  s = palloc_get_multiple_tagged (0, 1, c->tag);
+  if (s == NULL)
+    return NULL;
+
+  s->magic = SLAB_MAGIC;
+  s->cache = c;
+  s->in_use = 0;
+  s->free = NULL;
+
+  /* Chain the slots so that the lowest comes first. */
+  slot = (uint8_t *) s + c->first_ofs + c->objs_per_slab * c->slot_size;
+  for (i = 0; i < c->objs_per_slab; i++) 
+    {
+      slot -= c->slot_size;
+      if (c->ctor != NULL)
+        c->ctor (slot);
+      *slot_link (c, slot) = s->free;
+      s->free = slot;
+    }
+
+  c->total += c->objs_per_slab;
+  c->slab_cnt++;
+  return s;
+}
+
+/* Gives empty slab S, not on any list, of cache C, which must be
+   locked, back to the page allocator. */
+static void
+release_slab (struct kmem_cache *c, struct slab *s) 
+{
+  ASSERT (s->in_use == 0);
+
+  s->magic = 0;
+  c->total -= c->objs_per_slab;
+  c->slab_cnt--;
+  palloc_free_page (s);
+}
+
+/* Returns the slab that holds OBJ, checking that it belongs to
+   cache C. */
+static struct slab *
+obj_to_slab (struct kmem_cache *c, void *obj) 
+{
+  struct slab *s = pg_round_down (obj);
+
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT (s->cache == c);
+  ASSERT ((pg_ofs (obj) - c->first_ofs) % c->slot_size == 0);
+  return s;
+}
@@ -0,0 +1,61 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <list.h>
+#include <stddef.h>
+#include "threads/memstat.h"
+#include "threads/synch.h"
+
+/* An object cache.
+
+   Hands out objects of a single size from "slabs", pages carved
+   into equal slots, so that frequently allocated kernel
+   structures neither round up to malloc()'s power-of-2 block
+   sizes nor share free lists with unrelated allocations.  See
+   slab.c for details. */
+struct kmem_cache
+  {
+    const char *name;           /* Name, for statistics. */
+    size_t obj_size;            /* Object size in bytes. */
+    size_t slot_size;           /* Bytes per object slot. */
+    size_t link_ofs;            /* Offset of free link in a slot. */
+    size_t first_ofs;           /* Offset of first slot in a slab. */
+    size_t objs_per_slab;       /* Number of slots in a slab. */
+    void (*ctor) (void *);      /* Object constructor, or null. */
+    enum mem_tag tag;           /* Subsystem charged for slabs. */
+
+    struct lock lock;           /* Protects the rest. */
+    struct list partial;        /* Slabs with some free objects. */
+    struct list full;           /* Slabs with no free objects. */
+    struct slab *spare;         /* Empty slab kept for reuse, or null. */
+    size_t active;              /* Objects allocated. */
+    size_t total;               /* Objects in all slabs. */
+    size_t slab_cnt;            /* Number of slabs. */
+
+    struct list_elem elem;      /* Element in list of all caches. */
+  };
+
+/* Statistics for a cache, from kmem_cache_get_stats(). */
+struct kmem_cache_stats
+  {
+    size_t obj_size;            /* Object size in bytes. */
+    size_t active;              /* Objects allocated. */
+    size_t total;               /* Objects in all slabs. */
+    size_t slab_cnt;            /* Number of slabs, one page each. */
+  };
+
+void kmem_cache_init_tagged (struct kmem_cache *, const char *name,
+                             size_t size, size_t align,
+                             void (*ctor) (void *), enum mem_tag);
+void *kmem_cache_alloc (struct kmem_cache *) __attribute__ ((malloc));
+void *kmem_cache_zalloc (struct kmem_cache *) __attribute__ ((malloc));
+void kmem_cache_free (struct kmem_cache *, void *);
+void kmem_cache_shrink (struct kmem_cache *);
+void kmem_cache_get_stats (struct kmem_cache *, struct kmem_cache_stats *);
+void kmem_cache_print_stats (void);
+
+/* Charge the cache's slabs to the caller's subsystem. */
+#define kmem_cache_init(CACHE, NAME, SIZE, ALIGN, CTOR) \
+        kmem_cache_init_tagged (CACHE, NAME, SIZE, ALIGN, CTOR, MEM_TAG)
+
+#endif /* threads/slab.h */
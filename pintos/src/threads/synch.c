@@ -30,10 +30,47 @@
 #include <stdio.h>
 #include <string.h>
 #include "threads/interrupt.h"
+#include "threads/latency.h"
+#include "threads/lockstat.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
+#include "threads/tsc.h"
 
 bool sema_yield = true;
 
+static void sema_catch_up_waiters (struct semaphore *);
+static void cond_catch_up_waiters (struct condition *);
+static void cond_wake_first (struct condition *);
+
+/* One semaphore in a list. */
+struct semaphore_elem 
+  {
+    struct list_elem elem;              /* List element. */
+    struct semaphore semaphore;         /* This semaphore. */
+    struct thread *thread;              /* Thread waiting on SEMAPHORE. */
+    struct condition *cond;             /* Condition whose waiters hold ELEM. */
+  };
+
+/* Orders threads in a semaphore's waiters by descending
+   priority.  Threads of equal priority keep FIFO order, since
+   list_insert_ordered() inserts after equal elements. */
+static bool
+thread_priority_more_list (const struct list_elem *a,
+                           const struct list_elem *b, void *aux UNUSED)
+{
+  return (list_entry (a, struct thread, elem)->priority
+          > list_entry (b, struct thread, elem)->priority);
+}
+
+/* Same, for the semaphore_elems in a condition's waiters. */
+static bool
+semaphore_elem_priority_more (const struct list_elem *a,
+                              const struct list_elem *b, void *aux UNUSED)
+{
+  return (list_entry (a, struct semaphore_elem, elem)->thread->priority
+          > list_entry (b, struct semaphore_elem, elem)->thread->priority);
+}
+
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
    manipulating it:
@@ -50,11 +87,15 @@ sema_init (struct semaphore *sema, unsigned value)
 
   sema->value = value;
   list_init (&sema->waiters);
+  sema->mlfqs_epoch = thread_mlfqs_epoch ();
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
    to become positive and then atomically decrements it.
 
+   Waiters are kept sorted by priority, highest first, so that
+   sema_up() wakes the front one in constant time.
+
    This function may sleep, so it must not be called within an
    interrupt handler.  This function may be called with
    interrupts disabled, but if it sleeps then the next scheduled
@@ -70,7 +111,12 @@ sema_down (struct semaphore *sema)
   old_level = intr_disable ();
   while (sema->value == 0) 
     {
-      list_push_back (&sema->waiters, &thread_current ()->elem);
+      /* Keeps SEMA's waiters up to date, see
+         sema_catch_up_waiters(). */
+      thread_mlfqs_catch_up (thread_current ());
+      thread_current ()->waiting_sema = sema;
+      list_insert_ordered (&sema->waiters, &thread_current ()->elem,
+                           thread_priority_more_list, NULL);
       thread_block ();
     }
   sema->value--;
@@ -114,9 +160,16 @@ sema_up (struct semaphore *sema)
   ASSERT (sema != NULL);
 
   old_level = intr_disable ();
-  if (!list_empty (&sema->waiters)) {
-    thread_unblock(thread_remove_highest_priority_thread(&sema->waiters));
-  }
+  if (!list_empty (&sema->waiters)) 
+    {
+      struct thread *t;
+
+      if (thread_mlfqs)
+        sema_catch_up_waiters (sema);
+      t = list_entry (list_pop_front (&sema->waiters), struct thread, elem);
+      t->waiting_sema = NULL;
+      thread_unblock (t);
+    }
   sema->value++;
   intr_set_level (old_level);  
   //if (!intr_context() && threading_started && sema_yield) {
@@ -124,6 +177,66 @@ sema_up (struct semaphore *sema)
   //}
 }
 
+/* Under -mlfqs, a blocked thread's recent_cpu decays lazily, so
+   its priority, and with it its place among SEMA's waiters, may
+   be out of date.  Brings every waiter up to date, which moves
+   it to its proper place, so that the front waiter really is the
+   highest priority one.
+
+   Waiters only go out of date when recent_cpu decays, once per
+   second, and every thread is brought up to date before it is
+   added to the waiters.  So the walk is only needed on the first
+   call after each decay, which SEMA's epoch records; other calls
+   return at once.  Interrupts must be off. */
+static void
+sema_catch_up_waiters (struct semaphore *sema) 
+{
+  struct list_elem *e, *next;
+  int64_t epoch = thread_mlfqs_epoch ();
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (sema->mlfqs_epoch == epoch)
+    return;
+  sema->mlfqs_epoch = epoch;
+
+  for (e = list_begin (&sema->waiters); e != list_end (&sema->waiters);
+       e = next)
+    {
+      next = list_next (e);
+      thread_mlfqs_catch_up (list_entry (e, struct thread, elem));
+    }
+}
+
+/* Moves blocked thread T, whose priority just changed, to its
+   new place among the waiters of the semaphore or condition it
+   waits on, if any.  Interrupts must be off.
+
+   A condition's waiters are otherwise protected by the monitor
+   lock, which the caller need not hold; with interrupts off no
+   other thread can be walking them. */
+void
+sema_reorder_waiter (struct thread *t) 
+{
+  struct semaphore *sema = t->waiting_sema;
+  struct semaphore_elem *waiter = t->cond_waiter;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (sema != NULL) 
+    {
+      list_remove (&t->elem);
+      list_insert_ordered (&sema->waiters, &t->elem,
+                           thread_priority_more_list, NULL);
+    }
+  if (waiter != NULL) 
+    {
+      list_remove (&waiter->elem);
+      list_insert_ordered (&waiter->cond->waiters, &waiter->elem,
+                           semaphore_elem_priority_more, NULL);
+    }
+}
+
 static void sema_test_helper (void *sema_);
 
 /* Self-test for semaphores that makes control "ping-pong"
@@ -175,14 +288,27 @@ sema_test_helper (void *sema_)
    another one "up" it, but with a lock the same thread must both
    acquire and release it.  When these restrictions prove
    onerous, it's a good sign that a semaphore should be used,
-   instead of a lock. */
+   instead of a lock.
+
+   lock_init() is a macro that passes its argument, as written,
+   and its call site to lock_init_at().  The call site names LOCK
+   in the -reportlatency report, and when built with LOCKSTAT,
+   LOCK is registered with the lock profiler under that name. */
 void
-lock_init (struct lock *lock)
+lock_init_at (struct lock *lock, const char *name UNUSED, const char *file,
+              int line)
 {
   ASSERT (lock != NULL);
 
   lock->holder = NULL;
   sema_init (&lock->semaphore, 1);
+  rb_init (&lock->donors, thread_priority_more, NULL);
+  lock->file = file;
+  lock->line = line;
+#ifdef LOCKSTAT
+  lock->class = lockstat_register (name, file, line);
+  lock->acquired_at = 0;
+#endif
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -200,11 +326,24 @@ lock_acquire (struct lock *lock)
   ASSERT (!intr_context ());
   ASSERT (!lock_held_by_current_thread (lock));
 
-  if (lock->holder) {
-    thread_donate_priority(thread_current(), lock->holder, lock);
+  uint64_t wait_start = 0;
+  bool contended = lock->holder != NULL;
+  if (contended) {
+    thread_donate_priority(thread_current(), lock);
+    trace_log(TRACE_LOCK_WAIT_BEGIN, (uint32_t) lock);
+    wait_start = rdtsc();
   }
   sema_down (&lock->semaphore);
-  lock->holder = thread_current ();
+  thread_hold_lock(thread_current(), lock);
+  if (contended) {
+    trace_log(TRACE_LOCK_WAIT_END, (uint32_t) lock);
+  }
+  if (contended && thread_report_latency) {
+    latency_lock_wait(thread_current(), lock, rdtsc() - wait_start);
+  }
+#ifdef LOCKSTAT
+  lockstat_acquired(lock, contended, contended ? rdtsc() - wait_start : 0);
+#endif
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -223,7 +362,12 @@ lock_try_acquire (struct lock *lock)
 
   success = sema_try_down (&lock->semaphore);
   if (success) 
-    lock->holder = thread_current ();
+    {
+      thread_hold_lock (thread_current (), lock);
+#ifdef LOCKSTAT
+      lockstat_acquired (lock, false, 0);
+#endif
+    }
   return success;
 }
 
@@ -238,10 +382,12 @@ lock_release (struct lock *lock)
   ASSERT (lock != NULL);
   ASSERT (lock_held_by_current_thread (lock));
 
-  lock->holder = NULL;
+#ifdef LOCKSTAT
+  lockstat_released (lock);
+#endif
   /*
     thread_restore_priority must be called before sema_up, 
-    because sema_up will cause one of the donors to be removed from waiters list
+    because sema_up may switch to a donor, which must find the lock released
   */
   thread_restore_priority(thread_current(), lock);
   sema_up (&lock->semaphore);
@@ -258,13 +404,6 @@ lock_held_by_current_thread (const struct lock *lock)
   return lock->holder == thread_current ();
 }
 
-/* One semaphore in a list. */
-struct semaphore_elem 
-  {
-    struct list_elem elem;              /* List element. */
-    struct semaphore semaphore;         /* This semaphore. */
-  };
-
 /* Initializes condition variable COND.  A condition variable
    allows one piece of code to signal a condition and cooperating
    code to receive the signal and act upon it. */
@@ -274,6 +413,7 @@ cond_init (struct condition *cond)
   ASSERT (cond != NULL);
 
   list_init (&cond->waiters);
+  cond->mlfqs_epoch = thread_mlfqs_epoch ();
 }
 
 /* Atomically releases LOCK and waits for COND to be signaled by
@@ -295,11 +435,16 @@ cond_init (struct condition *cond)
    This function may sleep, so it must not be called within an
    interrupt handler.  This function may be called with
    interrupts disabled, but interrupts will be turned back on if
-   we need to sleep. */
+   we need to sleep.
+
+   Waiters are kept sorted by priority, highest first.  The
+   entry is queued before LOCK is released, so that losing a
+   donation in lock_release() already moves it. */
 void
 cond_wait (struct condition *cond, struct lock *lock) 
 {
   struct semaphore_elem waiter;
+  enum intr_level old_level;
 
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
@@ -307,12 +452,58 @@ cond_wait (struct condition *cond, struct lock *lock)
   ASSERT (lock_held_by_current_thread (lock));
   
   sema_init (&waiter.semaphore, 0);
-  list_push_back (&cond->waiters, &waiter.elem);
+  waiter.thread = thread_current ();
+  waiter.cond = cond;
+  old_level = intr_disable ();
+  thread_mlfqs_catch_up (waiter.thread);
+  list_insert_ordered (&cond->waiters, &waiter.elem,
+                       semaphore_elem_priority_more, NULL);
+  waiter.thread->cond_waiter = &waiter;
+  intr_set_level (old_level);
   lock_release (lock);
   sema_down (&waiter.semaphore);
   lock_acquire (lock);
 }
 
+/* As sema_catch_up_waiters(), for COND's waiters.  Interrupts
+   must be off. */
+static void
+cond_catch_up_waiters (struct condition *cond) 
+{
+  struct list_elem *e, *next;
+  int64_t epoch = thread_mlfqs_epoch ();
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (cond->mlfqs_epoch == epoch)
+    return;
+  cond->mlfqs_epoch = epoch;
+
+  for (e = list_begin (&cond->waiters); e != list_end (&cond->waiters);
+       e = next)
+    {
+      next = list_next (e);
+      thread_mlfqs_catch_up (list_entry (e, struct semaphore_elem,
+                                         elem)->thread);
+    }
+}
+
+/* Removes the highest priority waiter from COND and wakes it.
+   COND must not be empty, and under -mlfqs its waiters must be
+   up to date.  Interrupts must be off. */
+static void
+cond_wake_first (struct condition *cond) 
+{
+  struct semaphore_elem *waiter;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  waiter = list_entry (list_pop_front (&cond->waiters),
+                       struct semaphore_elem, elem);
+  waiter->thread->cond_waiter = NULL;
+  sema_up (&waiter->semaphore);
+}
+
 /* If any threads are waiting on COND (protected by LOCK), then
    this function signals one of them to wake up from its wait.
    LOCK must be held before calling this function.
@@ -320,39 +511,29 @@ cond_wait (struct condition *cond, struct lock *lock)
    An interrupt handler cannot acquire a lock, so it does not
    make sense to try to signal a condition variable within an
    interrupt handler. */
-
-static bool thread_priority_less(struct list_elem *e1, struct list_elem *e2, void *aux) {
-  struct thread *t1 = list_entry(e1, struct thread, elem);
-  struct thread *t2 = list_entry(e2, struct thread, elem);
-  return t1->priority < t2->priority;
-}
-
-static bool semaphore_elem_priority_less(struct list_elem *e1, struct list_elem *e2, void *aux) {
-  struct semaphore_elem *se1 = list_entry(e1, struct semaphore_elem, elem);
-  struct semaphore_elem *se2 = list_entry(e2, struct semaphore_elem, elem);
-  int se1_priority_max = list_entry(list_max(&se1->semaphore.waiters, thread_priority_less, NULL), struct thread, elem)->priority;
-  int se2_priority_max = list_entry(list_max(&se2->semaphore.waiters, thread_priority_less, NULL), struct thread, elem)->priority;
-  return se1_priority_max < se2_priority_max;
-}
-
 void
 cond_signal (struct condition *cond, struct lock *lock UNUSED) 
 {
+  enum intr_level old_level;
+
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (lock_held_by_current_thread (lock));
 
-  if (!list_empty (&cond->waiters)) {
-    struct semaphore_elem *se = list_entry(list_max(&cond->waiters, semaphore_elem_priority_less, NULL), struct semaphore_elem, elem);
-    list_remove(&se->elem);
-    sema_up (&se->semaphore);
-  }
-    
+  old_level = intr_disable ();
+  if (!list_empty (&cond->waiters)) 
+    {
+      if (thread_mlfqs)
+        cond_catch_up_waiters (cond);
+      cond_wake_first (cond);
+    }
+  intr_set_level (old_level);
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
-   LOCK).  LOCK must be held before calling this function.
+   LOCK), highest priority first, in a single pass over its
+   waiters.  LOCK must be held before calling this function.
 
    An interrupt handler cannot acquire a lock, so it does not
    make sense to try to signal a condition variable within an
@@ -360,9 +541,142 @@ cond_signal (struct condition *cond, struct lock *lock UNUSED)
 void
 cond_broadcast (struct condition *cond, struct lock *lock) 
 {
+  enum intr_level old_level;
+
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (lock_held_by_current_thread (lock));
 
+  old_level = intr_disable ();
+  if (thread_mlfqs)
+    cond_catch_up_waiters (cond);
   while (!list_empty (&cond->waiters))
-    cond_signal (cond, lock);
+    cond_wake_first (cond);
+  intr_set_level (old_level);
+}
+
+/* Initializes RWLOCK.  Any number of readers may hold a
+   readers-writer lock at once, or a single writer.
+
+   Writers are preferred: once a writer is waiting, new readers
+   queue up behind it instead of joining the readers already
+   inside, so a stream of readers cannot starve it.  The writer
+   and the writer waiting for readers to leave both hold the
+   internal lock, so threads queued behind them donate their
+   priority to them as with any other lock.  A writer waiting
+   for readers to leave in turn donates its priority to each of
+   them, so a low priority reader cannot hold off a high
+   priority writer. */
+void
+rwlock_init_at (struct rwlock *rw, const char *name, const char *file,
+                int line)
+{
+  ASSERT (rw != NULL);
+
+  lock_init_at (&rw->lock, name, file, line);
+  rw->readers = 0;
+  list_init (&rw->reader_holds);
+  rw->writer_waiting = NULL;
+  sema_init (&rw->drained, 0);
+}
+
+/* Acquires RW for reading, sleeping while a writer holds it or
+   is waiting for it.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_read (struct rwlock *rw) 
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!lock_held_by_current_thread (&rw->lock));
+
+  /* Fast path: no writer, so just join the readers. */
+  old_level = intr_disable ();
+  if (rw->lock.holder == NULL) 
+    {
+      rw->readers++;
+      thread_hold_read (thread_current (), rw);
+      intr_set_level (old_level);
+      return;
+    }
+  intr_set_level (old_level);
+
+  /* Wait for the writer, donating to it, then join. */
+  lock_acquire (&rw->lock);
+  old_level = intr_disable ();
+  rw->readers++;
+  thread_hold_read (thread_current (), rw);
+  intr_set_level (old_level);
+  lock_release (&rw->lock);
+}
+
+/* Releases RW, which the current thread must hold for reading. */
+void
+rwlock_release_read (struct rwlock *rw) 
+{
+  enum intr_level old_level;
+  bool wake;
+
+  ASSERT (rw != NULL);
+
+  old_level = intr_disable ();
+  ASSERT (rw->readers > 0);
+  thread_release_read (thread_current (), rw);
+  wake = --rw->readers == 0 && rw->writer_waiting != NULL;
+  if (wake)
+    rw->writer_waiting = NULL;
+  if (wake)
+    sema_up (&rw->drained);
+  intr_set_level (old_level);
+}
+
+/* Acquires RW for writing, sleeping until no other writer holds
+   it and all readers have left.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_write (struct rwlock *rw) 
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+
+  lock_acquire (&rw->lock);
+  old_level = intr_disable ();
+  while (rw->readers > 0) 
+    {
+      rw->writer_waiting = thread_current ();
+      thread_donate_to_readers (thread_current (), rw);
+      sema_down (&rw->drained);
+    }
+  thread_readers_drained (thread_current ());
+  intr_set_level (old_level);
+}
+
+/* Releases RW, which the current thread must hold for writing. */
+void
+rwlock_release_write (struct rwlock *rw) 
+{
+  ASSERT (rw != NULL);
+  ASSERT (rwlock_write_held_by_current_thread (rw));
+
+  lock_release (&rw->lock);
+}
+
+/* Returns true if the current thread holds RW for writing,
+   false otherwise.  (Note that testing whether some other thread
+   holds a lock would be racy.) */
+bool
+rwlock_write_held_by_current_thread (const struct rwlock *rw) 
+{
+  ASSERT (rw != NULL);
+
+  return lock_held_by_current_thread (&rw->lock) && rw->readers == 0;
 }
@@ -2,21 +2,28 @@
 #define THREADS_SYNCH_H
 
 #include <list.h>
+#include <rbtree.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 extern bool sema_yield;
 
+struct thread;
+
 /* A counting semaphore. */
 struct semaphore 
   {
     unsigned value;             /* Current value. */
     struct list waiters;        /* List of waiting threads. */
+    int64_t mlfqs_epoch;        /* Decay the waiters were last
+                                   brought up to date for, -mlfqs. */
   };
 
 void sema_init (struct semaphore *, unsigned value);
 void sema_down (struct semaphore *);
 bool sema_try_down (struct semaphore *);
 void sema_up (struct semaphore *);
+void sema_reorder_waiter (struct thread *);
 void sema_self_test (void);
 
 /* Lock. */
@@ -24,9 +31,21 @@ struct lock
   {
     struct thread *holder;      /* Thread holding lock (for debugging). */
     struct semaphore semaphore; /* Binary semaphore controlling access. */
+    struct rb_tree donors;      /* Waiting threads, highest priority first. */
+    struct rb_elem holder_elem; /* Element in holder's held_locks. */
+    const char *file;           /* Source file of lock_init() call. */
+    int line;                   /* Source line of lock_init() call. */
+#ifdef LOCKSTAT
+    struct lock_class *class;   /* Profiling statistics, or NULL. */
+    uint64_t acquired_at;       /* rdtsc() when last acquired. */
+#endif
   };
 
-void lock_init (struct lock *);
+/* Records the call site, so that the profiler and -reportlatency
+   can name the lock. */
+#define lock_init(LOCK) lock_init_at (LOCK, #LOCK, __FILE__, __LINE__)
+void lock_init_at (struct lock *, const char *name, const char *file,
+                   int line);
 void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
@@ -36,6 +55,7 @@ bool lock_held_by_current_thread (const struct lock *);
 struct condition 
   {
     struct list waiters;        /* List of waiting threads. */
+    int64_t mlfqs_epoch;        /* As in struct semaphore. */
   };
 
 void cond_init (struct condition *);
@@ -43,6 +63,38 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Readers-writer lock. */
+struct rwlock 
+  {
+    struct lock lock;           /* Held by the writer, and by a writer
+                                   waiting for readers to leave. */
+    unsigned readers;           /* Number of readers inside. */
+    struct list reader_holds;   /* Readers' struct rwlock_reader. */
+    struct thread *writer_waiting; /* Writer blocked on DRAINED. */
+    struct semaphore drained;   /* Upped when the last reader leaves. */
+  };
+
+/* A thread's hold on a readers-writer lock for reading.  A writer
+   waiting for the readers to leave donates its priority to the
+   threads on the lock's reader_holds.  Kept in the reading
+   thread, see struct thread_priority_donation_info. */
+struct rwlock_reader 
+  {
+    struct list_elem elem;      /* Element in RW's reader_holds. */
+    struct rwlock *rw;          /* Lock held, or NULL if unused. */
+    struct thread *thread;      /* Reading thread. */
+    unsigned depth;             /* Number of nested read holds. */
+  };
+
+#define rwlock_init(RW) rwlock_init_at (RW, #RW, __FILE__, __LINE__)
+void rwlock_init_at (struct rwlock *, const char *name, const char *file,
+                     int line);
+void rwlock_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+bool rwlock_write_held_by_current_thread (const struct rwlock *);
+
 /* Optimization barrier.
 
    The compiler will not reorder operations across an
@@ -2,6 +2,7 @@
 #include "threads/thread.h"
 #undef ENABLE_FIXED_POINT
 #include <debug.h>
+#include <inttypes.h>
 #include <stddef.h>
 #include <random.h>
 #include <stdio.h>
@@ -9,6 +10,10 @@
 #include "devices/timer.h"
 #include "threads/flags.h"
 #include "threads/interrupt.h"
+#include "threads/latency.h"
+#include "threads/lockstat.h"
+#include "threads/trace.h"
+#include <rbtree.h>
 #include "threads/intr-stubs.h"
 #include "threads/palloc.h"
 #include "threads/switch.h"
@@ -23,17 +28,75 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes that are blocked due to timer_sleep call */
-static struct list sleeper_list;
+/* Run queue of processes in THREAD_READY state, that is,
+   processes that are ready to run but not actually running.
+   There is one FIFO list per priority level, and a bitmap of the
+   non-empty levels, so that enqueueing, dequeueing and picking
+   the highest priority thread all take constant time. */
+struct ready_queue
+  {
+    struct list levels[PRI_MAX + 1];    /* One FIFO per priority. */
+    uint32_t bitmap[(PRI_MAX + 32) / 32]; /* Non-empty levels. */
+    size_t cnt;                         /* Number of ready threads. */
+  };
+
+/* Run queues.  Which one is used depends on the scheduling
+   policy, see struct sched_ops. */
+static struct ready_queue ready_queue;  /* Priority-ordered ready threads. */
+static struct rb_tree cfs_rq;           /* Ready threads by vruntime, for -cfs. */
+static int64_t cfs_min_vruntime;        /* Monotonic lower bound on vruntimes. */
+
+/* A scheduling policy.  The policy owns the run queue: it
+   decides where a thread that becomes ready goes, which ready
+   thread runs next, and when the running thread has had its
+   share.  The run queue functions are called with interrupts
+   off. */
+struct sched_ops
+  {
+    /* Adds T, which is becoming ready, to the run queue. */
+    void (*enqueue) (struct thread *t);
+
+    /* Removes and returns the thread that should run next, or
+       returns a null pointer if no thread is ready. */
+    struct thread *(*pick_next) (void);
+
+    /* Returns the number of ready threads. */
+    size_t (*ready_cnt) (void);
+
+    /* Changes the priority of T, which is ready. */
+    void (*set_priority) (struct thread *t, int priority);
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+    /* Charges one timer tick to T, the running thread.  Returns
+       true if T should be preempted.  Interrupts are off. */
+    bool (*tick) (struct thread *t);
+  };
+
+static const struct sched_ops prio_sched_ops;
+static const struct sched_ops mlfqs_sched_ops;
+static const struct sched_ops cfs_sched_ops;
+
+/* Policy in use, chosen by thread_init(). */
+static const struct sched_ops *sched;
 
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
 static struct list all_list;
 
+/* Pages of dead threads, kept for reuse by thread_create() so
+   that creating a thread neither goes through the page allocator
+   nor zeroes a whole page: init_thread() only clears the struct
+   thread at the bottom of the page.  Linked through allelem,
+   which a dead thread no longer uses.  Accessed with interrupts
+   off. */
+static struct list thread_page_cache;
+static size_t thread_page_cache_cnt;
+
+/* Maximum number of pages kept in thread_page_cache.  Set it to
+   0 to turn the cache off: every dead thread's page then goes
+   straight back to the page allocator, and thread_create() takes
+   a zeroed page from it, as it did before the cache. */
+size_t thread_page_cache_max = 16;
+
 /* Idle thread. */
 static struct thread *idle_thread;
 
@@ -66,11 +129,31 @@ bool threading_started = false;
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
+
+/* If true, use the completely fair scheduler, which shares the
+   CPU among threads in proportion to weights derived from their
+   nice values and ignores priorities.
+   Controlled by kernel command-line option "-cfs". */
+bool thread_cfs;
 bool thread_report_latency;
 
 /* load_avg is a system wide value */
 fixed64 mlfqs_load_avg;
 
+/* 
+  recent_cpu decays once per second by a factor that depends on load_avg at that second.
+  Instead of decaying every thread's recent_cpu in the timer interrupt, 
+  the factor of each decay is remembered here, and a thread applies the decays it missed 
+  when it is next examined (see thread_mlfqs_recalculate_recent_cpu).
+  A thread that was not examined for longer than MLFQS_DECAY_HISTORY seconds has the decays
+  older than the history applied in closed form, using the oldest remembered factor.
+*/
+#define MLFQS_DECAY_HISTORY 64
+static fixed64 mlfqs_decay_history[MLFQS_DECAY_HISTORY];
+static int64_t mlfqs_epoch;             /* # of decays so far. */
+
+static void mlfqs_decay_ready_threads(void);
+
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
@@ -82,6 +165,18 @@ static void *alloc_frame (struct thread *, size_t size);
 static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
+static void ready_queue_init (struct ready_queue *);
+static void ready_queue_push (struct ready_queue *, struct thread *);
+static void ready_queue_remove (struct ready_queue *, struct thread *);
+static struct thread *ready_queue_pop_max (struct ready_queue *);
+static void thread_change_priority (struct thread *, int priority);
+static bool cfs_vruntime_less (const struct rb_elem *, const struct rb_elem *, void *aux);
+static rb_less_func lock_donated_priority_more;
+static void thread_update_donated_priority (struct thread *);
+static void thread_update_readers (struct rwlock *);
+static void thread_reposition_donor (struct thread *);
+static struct thread *thread_page_get (void);
+static void thread_page_put (struct thread *);
 
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
@@ -100,11 +195,19 @@ void
 thread_init (void) 
 {
   ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (!(thread_mlfqs && thread_cfs));
+
+  sched = thread_mlfqs ? &mlfqs_sched_ops
+          : thread_cfs ? &cfs_sched_ops
+          : &prio_sched_ops;
 
   lock_init (&tid_lock);
-  list_init (&sleeper_list);
-  list_init (&ready_list);
+  ready_queue_init (&ready_queue);
+  rb_init (&cfs_rq, cfs_vruntime_less, NULL);
+  cfs_min_vruntime = 0;
   list_init (&all_list);
+  list_init (&thread_page_cache);
+  latency_init ();
 
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread ();
@@ -121,6 +224,7 @@ thread_start (void)
   /* Create the idle thread. */
   struct semaphore idle_started;
   sema_init (&idle_started, 0);
+  latency_attach (initial_thread);
   thread_create ("idle", PRI_MIN, idle, &idle_started);
 
   /* Start preemptive thread scheduling. */
@@ -136,7 +240,6 @@ void
 thread_tick (void) 
 {
   struct thread *t = thread_current ();
-  int64_t current_time = timer_ticks();
 
   /* Update statistics. */
   if (t == idle_thread)
@@ -149,57 +252,10 @@ thread_tick (void)
     kernel_ticks++;
 
   /* Enforce preemption. */
-  if (++thread_ticks >= TIME_SLICE)
+  if (sched->tick (t))
     intr_yield_on_return ();
 
-  /*
-    wake up threads in sleeper_list
-    also, update their time related information
-  */
-  struct list_elem *cur, *next;
-  struct thread *cur_t;
-  /* list is sorted in increasing order */
-  if (!list_empty(&sleeper_list)) {
-    cur = list_begin(&sleeper_list);
-    while (cur != list_end(&sleeper_list)) {
-      next = list_next(cur);
-      cur_t = list_entry(cur, struct thread, sleep_info.elem);
-      if (cur_t->sleep_info.wakeup_time > timer_ticks()) {
-        break;
-      }
-      thread_exit_sleep(cur_t);
-      cur = next;
-    }
-  }
-
-  if (thread_mlfqs) {
-    if (t != idle_thread) {
-      t->mlfqs_recent_cpu = fixed64_add_int32(t->mlfqs_recent_cpu, 1);
-    }
-    if (current_time % TIMER_FREQ == 0) {
-      mlfqs_recalculate_load_avg();
-    }
-  }
-  
-  /* iterate all threads and update their time-related variables */
-  for (struct list_elem *e = list_begin(&all_list); e != list_end(&all_list); e = list_next(e)) {
-    /* increment timestamp */
-    struct thread *cur_t = list_entry(e, struct thread, allelem);
-    cur_t->thread_ticks++;
-    if (cur_t == idle_thread) {
-      continue;
-    }
-    /* do mlfqs related stuff */
-    if (thread_mlfqs) {
-      if (current_time % 4 == 0) {
-        thread_mlfqs_recalculate_priority(cur_t);
-      }
-      if (current_time % TIMER_FREQ == 0) {
-        thread_mlfqs_recalculate_recent_cpu(cur_t);
-      }
-    }
-  }
-  
+  /* sleeping threads are woken up by their sleep_info.timer, which the timer wheel fires before calling us */
 }
 
 /* Prints thread statistics. */
@@ -208,6 +264,8 @@ thread_print_stats (void)
 {
   printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
           idle_ticks, kernel_ticks, user_ticks);
+  latency_print_stats ();
+  lockstat_print ();
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -238,13 +296,14 @@ thread_create (const char *name, int priority,
   ASSERT (function != NULL);
 
   /* Allocate thread. */
-  t = palloc_get_page (PAL_ZERO);
+  t = thread_page_get ();
   if (t == NULL)
     return TID_ERROR;
 
   /* Initialize thread. */
   init_thread (t, name, priority);
   tid = t->tid = allocate_tid ();
+  latency_attach (t);
 
   /* Stack frame for kernel_thread(). */
   kf = alloc_frame (t, sizeof *kf);
@@ -300,7 +359,9 @@ thread_unblock (struct thread *t)
 
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
-  list_push_back (&ready_list, &t->elem);
+  thread_mlfqs_catch_up (t);
+  latency_ready (t);
+  sched->enqueue (t);
   t->status = THREAD_READY;
   intr_set_level (old_level);
 }
@@ -348,6 +409,8 @@ thread_exit (void)
 #ifdef USERPROG
   process_exit ();
 #endif
+  latency_exit (thread_current ());
+  malloc_thread_exit ();
 
   /* Remove thread from all threads list, set our status to dying,
      and schedule another process.  That process will destroy us
@@ -355,7 +418,7 @@ thread_exit (void)
   intr_disable ();
   list_remove (&thread_current()->allelem);
   if (thread_report_latency) {
-    printf("Thread %s completed in %d ticks\n", thread_current()->name, thread_current()->thread_ticks);
+    printf("Thread %s completed in %"PRId64" ticks\n", thread_current()->name, timer_elapsed(thread_current()->start_ticks));
   }
   thread_current ()->status = THREAD_DYING;
   schedule ();
@@ -374,7 +437,7 @@ thread_yield (void)
 
   old_level = intr_disable ();
   if (cur != idle_thread) 
-    list_push_back (&ready_list, &cur->elem);
+    sched->enqueue (cur);
   cur->status = THREAD_READY;
   schedule ();
   intr_set_level (old_level);
@@ -401,18 +464,13 @@ thread_foreach (thread_action_func *func, void *aux)
 void
 thread_set_priority (int new_priority) 
 {
-  int original_priority = thread_get_priority(), real_new_priority;
   struct thread *current = thread_current();
-  struct list *donor_threads_list = &current->priority_donation_info.donor_threads_list;
-  thread_current()->priority_donation_info.genesis_priority = new_priority;
-  /* recalculate priority here */
-  real_new_priority = new_priority;
-  for (struct list_elem *e = list_begin(donor_threads_list); e != list_end(donor_threads_list); e = list_next(e)) {
-    struct thread *t = list_entry(e, struct thread, priority_donation_info.elem);
-    real_new_priority = t->priority > real_new_priority ? t->priority : real_new_priority;
-  }
-  thread_current()->priority = real_new_priority;
-  if (original_priority > real_new_priority) {
+  int original_priority = current->priority;
+  enum intr_level old_level = intr_disable();
+  current->priority_donation_info.genesis_priority = new_priority;
+  thread_update_donated_priority(current);
+  intr_set_level(old_level);
+  if (original_priority > current->priority) {
     thread_yield();
   }
 }
@@ -426,20 +484,34 @@ thread_get_priority (void)
 
 /* Sets the current thread's nice value to NICE. */
 void
-thread_set_nice (int nice UNUSED) 
+thread_set_nice (int nice) 
 {
-  ASSERT(thread_mlfqs);
+  ASSERT(thread_mlfqs || thread_cfs);
+  ASSERT(NICE_MIN <= nice && nice <= NICE_MAX);
   struct thread *current = thread_current();
-  current->mlfqs_nice = nice;
+  if (thread_cfs) {
+    /* takes effect at the next tick, as the weight only matters when vruntime is charged */
+    current->nice = nice;
+    return;
+  }
+  int original_priority = current->priority;
+  enum intr_level old_level = intr_disable();
+  thread_mlfqs_recalculate_recent_cpu(current);
+  current->nice = nice;
+  thread_mlfqs_recalculate_priority(current);
+  intr_set_level(old_level);
+  if (current->priority < original_priority) {
+    thread_yield();
+  }
 }
 
 /* Returns the current thread's nice value. */
 int
 thread_get_nice (void) 
 {
-  ASSERT(thread_mlfqs);
+  ASSERT(thread_mlfqs || thread_cfs);
   struct thread *current = thread_current();
-  return current->mlfqs_nice;
+  return current->nice;
 }
 
 /* Returns 100 times the system load average. */
@@ -457,6 +529,9 @@ thread_get_recent_cpu (void)
 {
   ASSERT(thread_mlfqs);
   struct thread *current = thread_current();
+  enum intr_level old_level = intr_disable();
+  thread_mlfqs_recalculate_recent_cpu(current);
+  intr_set_level(old_level);
   return fixed64_to_int32(fixed64_mul_int32(current->mlfqs_recent_cpu, 100));
 }
 
@@ -482,6 +557,10 @@ idle (void *idle_started_ UNUSED)
       intr_disable ();
       thread_block ();
 
+      /* Stop the periodic timer tick until there is something to
+         do, if "-tickless" was given. */
+      timer_idle_enter ();
+
       /* Re-enable interrupts and wait for the next one.
 
          The `sti' instruction disables interrupts until the
@@ -530,18 +609,21 @@ is_thread (struct thread *t)
   return t != NULL && t->magic == THREAD_MAGIC;
 }
 
+static void thread_sleep_timer_expired(void *t_) {
+  thread_exit_sleep(t_);
+}
+
 static void init_thread_sleep_info(struct thread *t) {
-  t->sleep_info.elem.next = NULL;
-  t->sleep_info.elem.prev = NULL;
+  timer_event_init(&t->sleep_info.timer, thread_sleep_timer_expired, t);
   t->sleep_info.is_sleeping = false;
   t->sleep_info.wakeup_time = 0;
 }
 
 static void init_thread_priority_donation_info(struct thread *t) {
   t->priority_donation_info.genesis_priority = t->priority;
-  t->priority_donation_info.lock = NULL;
-  t->priority_donation_info.recipient = NULL;
-  list_init(&t->priority_donation_info.donor_threads_list);
+  t->priority_donation_info.waiting_lock = NULL;
+  t->priority_donation_info.waiting_rwlock = NULL;
+  rb_init(&t->priority_donation_info.held_locks, lock_donated_priority_more, NULL);
 }
 
 /* Does basic initialization of T as a blocked thread named
@@ -576,9 +658,11 @@ init_thread (struct thread *t, const char *name, int priority)
 
   init_thread_sleep_info(t);
   init_thread_priority_donation_info(t);
-  t->thread_ticks = 0;
-  t->mlfqs_nice = 0;
+  t->start_ticks = timer_ticks();
+  t->nice = NICE_DEFAULT;
   t->mlfqs_recent_cpu = 0;
+  t->mlfqs_epoch = mlfqs_epoch;
+  t->cfs_vruntime = cfs_min_vruntime;
   intr_set_level (old_level);
 }
 
@@ -603,11 +687,9 @@ alloc_frame (struct thread *t, size_t size)
 static struct thread *
 next_thread_to_run (void) 
 {
-  if (list_empty (&ready_list))
-    return idle_thread;
-  else {
-    return thread_remove_highest_priority_thread(&ready_list);
-  }
+  struct thread *t = sched->pick_next ();
+
+  return t != NULL ? t : idle_thread;
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -652,7 +734,7 @@ thread_schedule_tail (struct thread *prev)
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread) 
     {
       ASSERT (prev != cur);
-      palloc_free_page (prev);
+      thread_page_put (prev);
     }
 }
 
@@ -677,8 +759,13 @@ schedule (void)
   }
   ASSERT (is_thread (next));
 
-  if (cur != next)
-    prev = switch_threads (cur, next);
+  if (cur != next) 
+    {
+      latency_switch (cur, next);
+      if (trace_enabled)
+        trace_record (TRACE_SWITCH, cur->tid, next->tid);
+      prev = switch_threads (cur, next);
+    }
   thread_schedule_tail (prev);
 }
 
@@ -700,14 +787,6 @@ allocate_tid (void)
    Used by switch.S, which can't figure it out on its own. */
 uint32_t thread_stack_ofs = offsetof (struct thread, stack);
 
-static bool thread_wakeup_time_less(struct list_elem *e1, struct list_elem *e2, void *aux) {
-  struct thread *t1 = list_entry(e1, struct thread, sleep_info.elem);
-  struct thread *t2 = list_entry(e2, struct thread, sleep_info.elem);
-  ASSERT(t1->sleep_info.is_sleeping);
-  ASSERT(t2->sleep_info.is_sleeping);
-  return t1->sleep_info.wakeup_time < t2->sleep_info.wakeup_time;
-}
-
 /* Sets up t->sleep_info and blocks the current thread */
 bool thread_enter_sleep(int64_t sleep_ticks) {
   ASSERT(thread_current()->sleep_info.is_sleeping == false);
@@ -716,7 +795,7 @@ bool thread_enter_sleep(int64_t sleep_ticks) {
     struct thread *t = thread_current();
     t->sleep_info.is_sleeping = true;
     t->sleep_info.wakeup_time = timer_ticks() + sleep_ticks;
-    list_insert_ordered(&sleeper_list, &t->sleep_info.elem, thread_wakeup_time_less, NULL);
+    timer_event_arm(&t->sleep_info.timer, t->sleep_info.wakeup_time);
     thread_block();
     intr_set_level(old_level);
     return true;
@@ -734,7 +813,7 @@ bool thread_exit_sleep(struct thread *t) {
   if (t->sleep_info.wakeup_time <= timer_ticks()) {
     t->sleep_info.is_sleeping = false;
     t->sleep_info.wakeup_time = 0;
-    list_remove(&t->sleep_info.elem);
+    timer_event_cancel(&t->sleep_info.timer);
     thread_unblock(t);
     result = true;
     goto done;
@@ -744,10 +823,29 @@ bool thread_exit_sleep(struct thread *t) {
     return result;
 }
 
-static bool thread_priority_less(struct list_elem *e1, struct list_elem *e2, void *aux) {
-  struct thread *t1 = list_entry(e1, struct thread, elem);
-  struct thread *t2 = list_entry(e2, struct thread, elem);
-  return t1->priority < t2->priority;
+static void ready_queue_init(struct ready_queue *rq) {
+  for (int i = PRI_MIN; i <= PRI_MAX; i++) {
+    list_init(&rq->levels[i]);
+  }
+  memset(rq->bitmap, 0, sizeof rq->bitmap);
+  rq->cnt = 0;
+}
+
+/* appends t to the tail of its priority level, so threads of equal priority run in FIFO order */
+static void ready_queue_push(struct ready_queue *rq, struct thread *t) {
+  ASSERT(PRI_MIN <= t->priority && t->priority <= PRI_MAX);
+  list_push_back(&rq->levels[t->priority], &t->elem);
+  rq->bitmap[t->priority / 32] |= 1u << (t->priority % 32);
+  rq->cnt++;
+}
+
+/* t must be queued at level t->priority */
+static void ready_queue_remove(struct ready_queue *rq, struct thread *t) {
+  list_remove(&t->elem);
+  if (list_empty(&rq->levels[t->priority])) {
+    rq->bitmap[t->priority / 32] &= ~(1u << (t->priority % 32));
+  }
+  rq->cnt--;
 }
 
 /* 
@@ -755,81 +853,442 @@ static bool thread_priority_less(struct list_elem *e1, struct list_elem *e2, voi
   because it is called by schedule, where current_thread state is THREAD_BLOCKED
   an example function is printf
  */
-struct thread *thread_remove_highest_priority_thread(struct list *thread_list) {
-  ASSERT(!list_empty(thread_list));
-  struct list_elem *e = list_max(thread_list, thread_priority_less, NULL);
-  list_remove(e);
-  return list_entry(e, struct thread, elem);
+static struct thread *ready_queue_pop_max(struct ready_queue *rq) {
+  int word, priority;
+  struct thread *t;
+  ASSERT(rq->cnt > 0);
+  for (word = sizeof rq->bitmap / sizeof *rq->bitmap - 1; rq->bitmap[word] == 0; word--) {
+    ASSERT(word > 0);
+  }
+  /* index of the highest set bit, i.e. bsr */
+  priority = word * 32 + 31 - __builtin_clz(rq->bitmap[word]);
+  t = list_entry(list_front(&rq->levels[priority]), struct thread, elem);
+  ready_queue_remove(rq, t);
+  return t;
 }
 
-#define SWAP(type, x1, x2) { type tmp = x1; x1 = x2; x2 = tmp; }
+/* Sets t's effective priority. A ready thread is moved to the tail of its new level. */
+static void thread_change_priority(struct thread *t, int priority) {
+  enum intr_level old_level = intr_disable();
+  if (t->priority != priority) {
+    if (t->status == THREAD_READY) {
+      sched->set_priority(t, priority);
+    }
+    else {
+      t->priority = priority;
+      sema_reorder_waiter(t);
+    }
+    thread_reposition_donor(t);
+  }
+  intr_set_level(old_level);
+}
 
-void thread_donate_priority(struct thread *donor, struct thread *recipient, struct lock *lock) {
-  ASSERT(is_thread(donor));
-  ASSERT(is_thread(recipient));
-  if (recipient->priority > donor->priority) {
-    return;
+/* round-robin among the threads of the highest priority, see struct ready_queue. */
+static void prio_enqueue(struct thread *t) {
+  ready_queue_push(&ready_queue, t);
+}
+
+static struct thread *prio_pick_next(void) {
+  return ready_queue.cnt != 0 ? ready_queue_pop_max(&ready_queue) : NULL;
+}
+
+static size_t prio_ready_cnt(void) {
+  return ready_queue.cnt;
+}
+
+static void prio_set_priority(struct thread *t, int priority) {
+  ready_queue_remove(&ready_queue, t);
+  t->priority = priority;
+  ready_queue_push(&ready_queue, t);
+}
+
+static bool prio_tick(struct thread *t UNUSED) {
+  return ++thread_ticks >= TIME_SLICE;
+}
+
+static const struct sched_ops prio_sched_ops = {
+  .enqueue = prio_enqueue,
+  .pick_next = prio_pick_next,
+  .ready_cnt = prio_ready_cnt,
+  .set_priority = prio_set_priority,
+  .tick = prio_tick,
+};
+
+/*
+  the 4.4BSD scheduler uses the same run queue, and computes the priorities itself.
+  only the running thread's recent_cpu changes from tick to tick, so that is the only 
+  thread whose priority needs recalculation every fourth tick.
+  Once per second every recent_cpu decays: ready threads are brought up to date right away
+  because their priority decides who runs next. blocked threads catch up when sema_up or
+  cond_signal choose among the waiters, and again in thread_unblock.
+*/
+static bool mlfqs_tick(struct thread *t) {
+  int64_t current_time = timer_ticks();
+  if (t != idle_thread) {
+    t->mlfqs_recent_cpu = fixed64_add_int32(t->mlfqs_recent_cpu, 1);
+  }
+  if (current_time % TIMER_FREQ == 0) {
+    mlfqs_recalculate_load_avg();
+    mlfqs_decay_history[mlfqs_epoch % MLFQS_DECAY_HISTORY] = fixed64_div(
+      fixed64_mul_int32(mlfqs_load_avg, 2),
+      fixed64_add_int32(fixed64_mul_int32(mlfqs_load_avg, 2), 1));
+    mlfqs_epoch++;
+    mlfqs_decay_ready_threads();
+  }
+  if (t != idle_thread && current_time % 4 == 0) {
+    thread_mlfqs_recalculate_recent_cpu(t);
+    thread_mlfqs_recalculate_priority(t);
   }
+  return prio_tick(t);
+}
 
-  ASSERT(donor->priority_donation_info.recipient == NULL);
-  recipient->priority = donor->priority;
-  donor->priority_donation_info.lock = lock;
-  donor->priority_donation_info.recipient = recipient;
-  list_push_back(&recipient->priority_donation_info.donor_threads_list, &donor->priority_donation_info.elem);
+static const struct sched_ops mlfqs_sched_ops = {
+  .enqueue = prio_enqueue,
+  .pick_next = prio_pick_next,
+  .ready_cnt = prio_ready_cnt,
+  .set_priority = prio_set_priority,
+  .tick = mlfqs_tick,
+};
+
+/*
+  completely fair scheduler.
+  every thread accumulates virtual runtime while it runs, at a rate inversely proportional
+  to the weight of its nice value, and the ready thread with the least vruntime runs next.
+  over time every thread therefore gets cpu time in proportion to its weight.
+  vruntime is counted in units of CFS_TICK per tick at nice 0.
+*/
+#define CFS_TICK 1024
+#define CFS_NICE_0_WEIGHT 1024
+
+/* a thread that was running ahead of the least vruntime by more than this is preempted */
+#define CFS_PREEMPT_GRANULARITY CFS_TICK
+/* a waking thread is placed at most this far behind the least vruntime, so that
+   sleeping does not bank an unbounded claim on the cpu */
+#define CFS_SLEEPER_CREDIT (CFS_TICK * TIME_SLICE / 2)
+
+/* weight of each nice value from NICE_MIN to NICE_MAX, each ~1.25 times the next, as in linux */
+static const int32_t cfs_nice_weight[NICE_MAX - NICE_MIN + 1] = {
+  /* -20 */ 88761, 71755, 56483, 46273, 36291,
+  /* -15 */ 29154, 23254, 18705, 14949, 11916,
+  /* -10 */  9548,  7620,  6100,  4904,  3906,
+  /*  -5 */  3121,  2501,  1991,  1586,  1277,
+  /*   0 */  1024,   820,   655,   526,   423,
+  /*   5 */   335,   272,   215,   172,   137,
+  /*  10 */   110,    87,    70,    56,    45,
+  /*  15 */    36,    29,    23,    18,    15,
+  /*  20 */    12,
+};
+
+static bool cfs_vruntime_less(const struct rb_elem *a, const struct rb_elem *b, void *aux UNUSED) {
+  return rb_entry(a, struct thread, cfs_elem)->cfs_vruntime < rb_entry(b, struct thread, cfs_elem)->cfs_vruntime;
+}
 
-  struct thread *cur = recipient, *next;
-  while(1) {
-    next = cur->priority_donation_info.recipient;
-    if (next == NULL) {
-      break;
+/* min_vruntime only moves forward, following the least of the running and ready vruntimes */
+static void cfs_update_min_vruntime(struct thread *running) {
+  int64_t min = INT64_MAX;
+  struct rb_elem *first = rb_first(&cfs_rq);
+  if (running != NULL && running != idle_thread) {
+    min = running->cfs_vruntime;
+  }
+  if (first != NULL && rb_entry(first, struct thread, cfs_elem)->cfs_vruntime < min) {
+    min = rb_entry(first, struct thread, cfs_elem)->cfs_vruntime;
+  }
+  if (min != INT64_MAX && min > cfs_min_vruntime) {
+    cfs_min_vruntime = min;
+  }
+}
+
+static void cfs_enqueue(struct thread *t) {
+  if (t->status == THREAD_BLOCKED) {
+    int64_t floor = cfs_min_vruntime - CFS_SLEEPER_CREDIT;
+    if (t->cfs_vruntime < floor) {
+      t->cfs_vruntime = floor;
     }
-    if (cur->priority > next->priority) {
-      // DO NOT list_push_back here. cur is already included in next's donor_threads_list
-      next->priority = cur->priority;
-      cur = next;
+  }
+  rb_insert(&cfs_rq, &t->cfs_elem);
+}
+
+static struct thread *cfs_pick_next(void) {
+  struct rb_elem *first = rb_first(&cfs_rq);
+  struct thread *t;
+  if (first == NULL) {
+    return NULL;
+  }
+  t = rb_entry(first, struct thread, cfs_elem);
+  rb_remove(&cfs_rq, first);
+  cfs_update_min_vruntime(t);
+  return t;
+}
+
+static size_t cfs_ready_cnt(void) {
+  return rb_size(&cfs_rq);
+}
+
+/* priorities do not affect the order of the cfs run queue */
+static void cfs_set_priority(struct thread *t, int priority) {
+  t->priority = priority;
+}
+
+static bool cfs_tick(struct thread *t) {
+  struct rb_elem *first = rb_first(&cfs_rq);
+  if (t == idle_thread) {
+    return first != NULL;
+  }
+  t->cfs_vruntime += CFS_TICK * CFS_NICE_0_WEIGHT / cfs_nice_weight[t->nice - NICE_MIN];
+  cfs_update_min_vruntime(t);
+  return first != NULL 
+    && t->cfs_vruntime - rb_entry(first, struct thread, cfs_elem)->cfs_vruntime > CFS_PREEMPT_GRANULARITY;
+}
+
+static const struct sched_ops cfs_sched_ops = {
+  .enqueue = cfs_enqueue,
+  .pick_next = cfs_pick_next,
+  .ready_cnt = cfs_ready_cnt,
+  .set_priority = cfs_set_priority,
+  .tick = cfs_tick,
+};
+
+/* 
+  returns a page for a new thread, preferably a cached one. its contents are garbage,
+  unless the cache is off (see thread_page_cache_max).
+*/
+static struct thread *thread_page_get(void) {
+  struct thread *t = NULL;
+  enum intr_level old_level = intr_disable();
+  if (!list_empty(&thread_page_cache)) {
+    t = list_entry(list_pop_front(&thread_page_cache), struct thread, allelem);
+    thread_page_cache_cnt--;
+  }
+  intr_set_level(old_level);
+  if (t == NULL) {
+    t = palloc_get_page(thread_page_cache_max != 0 ? 0 : PAL_ZERO);
+  }
+  return t;
+}
+
+/* caches the page of dead thread t, or frees it if the cache is full. */
+static void thread_page_put(struct thread *t) {
+  ASSERT(intr_get_level() == INTR_OFF);
+  if (thread_page_cache_cnt < thread_page_cache_max) {
+    list_push_front(&thread_page_cache, &t->allelem);
+    thread_page_cache_cnt++;
+  }
+  else {
+    palloc_free_page(t);
+  }
+}
+
+/* orders threads by descending priority; equal priorities stay in FIFO order */
+bool thread_priority_more(const struct rb_elem *a, const struct rb_elem *b, void *aux UNUSED) {
+  return rb_entry(a, struct thread, priority_donation_info.donor_elem)->priority
+    > rb_entry(b, struct thread, priority_donation_info.donor_elem)->priority;
+}
+
+/* the priority lock donates to its holder: that of its highest priority waiter */
+static int lock_donated_priority(const struct lock *lock) {
+  struct rb_elem *top = rb_first(&lock->donors);
+  if (top == NULL) {
+    return PRI_MIN - 1;
+  }
+  return rb_entry(top, struct thread, priority_donation_info.donor_elem)->priority;
+}
+
+static bool lock_donated_priority_more(const struct rb_elem *a, const struct rb_elem *b, void *aux UNUSED) {
+  return lock_donated_priority(rb_entry(a, struct lock, holder_elem))
+    > lock_donated_priority(rb_entry(b, struct lock, holder_elem));
+}
+
+/* the 4.4BSD scheduler computes priorities itself, and cfs ignores them; neither donates */
+static bool thread_donation_enabled(void) {
+  return !thread_mlfqs && !thread_cfs;
+}
+
+/* 
+  re-sorts t, whose priority just changed, in the donors of the lock it waits for, 
+  and that lock in its holder's held locks. interrupts must be off.
+*/
+static void thread_reposition_donor(struct thread *t) {
+  struct lock *lock = t->priority_donation_info.waiting_lock;
+  ASSERT(intr_get_level() == INTR_OFF);
+  if (lock == NULL) {
+    return;
+  }
+  rb_remove(&lock->donors, &t->priority_donation_info.donor_elem);
+  rb_insert(&lock->donors, &t->priority_donation_info.donor_elem);
+  if (lock->holder != NULL) {
+    struct rb_tree *held_locks = &lock->holder->priority_donation_info.held_locks;
+    rb_remove(held_locks, &lock->holder_elem);
+    rb_insert(held_locks, &lock->holder_elem);
+  }
+}
+
+/* 
+  recomputes t's effective priority from its genesis priority and the locks it holds.
+  if it changes, so may the priority of the holder of the lock t waits for, and so on 
+  down the chain; the walk stops at the first thread whose priority stays the same.
+  interrupts must be off.
+*/
+static void thread_update_donated_priority(struct thread *t) {
+  ASSERT(intr_get_level() == INTR_OFF);
+  while (t != NULL) {
+    struct thread_priority_donation_info *info = &t->priority_donation_info;
+    struct rb_elem *top = rb_first(&info->held_locks);
+    int priority = info->genesis_priority;
+    if (top != NULL) {
+      int donated = lock_donated_priority(rb_entry(top, struct lock, holder_elem));
+      priority = donated > priority ? donated : priority;
     }
-    else {
+    for (int i = 0; i < THREAD_READ_HOLDS; i++) {
+      struct rwlock *rw = info->read_holds[i].rw;
+      if (rw != NULL && rw->writer_waiting != NULL && rw->writer_waiting->priority > priority) {
+        priority = rw->writer_waiting->priority;
+      }
+    }
+    if (priority == t->priority) {
       break;
     }
+    thread_change_priority(t, priority);
+    if (info->waiting_rwlock != NULL) {
+      /* the donation fans out to every reader */
+      thread_update_readers(info->waiting_rwlock);
+      break;
+    }
+    t = info->waiting_lock != NULL ? info->waiting_lock->holder : NULL;
   }
 }
 
-void thread_restore_priority(struct thread *recipient, struct lock *lock) {
-  ASSERT(is_thread(recipient));
-  struct list *donor_threads_list = &recipient->priority_donation_info.donor_threads_list;
-  struct list_elem *cur, *next;
-  int priority = 0;
-  bool success = false;
-  if (!list_empty(donor_threads_list)) {
-    cur = list_begin(donor_threads_list);
-    while (cur != list_end(donor_threads_list)) {
-      next = list_next(cur);
-      struct thread *donor = list_entry(cur, struct thread, priority_donation_info.elem);
-      if (donor->priority_donation_info.lock == lock && donor->priority_donation_info.recipient == recipient) {
-        list_remove(&donor->priority_donation_info.elem);
-        donor->priority_donation_info.lock = NULL;
-        donor->priority_donation_info.recipient = NULL;
-        success = true;
-      }
-      cur = next;
-    }
-    if (!success) {
+/* passes a change in the priority of the writer waiting on rw on to its readers */
+static void thread_update_readers(struct rwlock *rw) {
+  struct list_elem *e;
+  ASSERT(intr_get_level() == INTR_OFF);
+  for (e = list_begin(&rw->reader_holds); e != list_end(&rw->reader_holds); e = list_next(e)) {
+    thread_update_donated_priority(list_entry(e, struct rwlock_reader, elem)->thread);
+  }
+}
+
+/* 
+  donor is about to wait for lock. if the lock was released in the meantime, donor stays 
+  among its donors and donates to whichever thread takes it next.
+*/
+void thread_donate_priority(struct thread *donor, struct lock *lock) {
+  ASSERT(is_thread(donor));
+  if (!thread_donation_enabled()) {
+    return;
+  }
+  enum intr_level old_level = intr_disable();
+  ASSERT(donor->priority_donation_info.waiting_lock == NULL);
+  donor->priority_donation_info.waiting_lock = lock;
+  rb_insert(&lock->donors, &donor->priority_donation_info.donor_elem);
+  if (lock->holder != NULL) {
+    struct rb_tree *held_locks = &lock->holder->priority_donation_info.held_locks;
+    rb_remove(held_locks, &lock->holder_elem);
+    rb_insert(held_locks, &lock->holder_elem);
+    thread_update_donated_priority(lock->holder);
+  }
+  intr_set_level(old_level);
+}
+
+/* holder has just acquired lock. the threads still waiting for it donate to holder now */
+void thread_hold_lock(struct thread *holder, struct lock *lock) {
+  ASSERT(is_thread(holder));
+  enum intr_level old_level = intr_disable();
+  lock->holder = holder;
+  if (!thread_donation_enabled()) {
+    intr_set_level(old_level);
+    return;
+  }
+  if (holder->priority_donation_info.waiting_lock == lock) {
+    rb_remove(&lock->donors, &holder->priority_donation_info.donor_elem);
+    holder->priority_donation_info.waiting_lock = NULL;
+  }
+  rb_insert(&holder->priority_donation_info.held_locks, &lock->holder_elem);
+  thread_update_donated_priority(holder);
+  intr_set_level(old_level);
+}
+
+/* holder is about to release lock, and loses the priority donated through it */
+void thread_restore_priority(struct thread *holder, struct lock *lock) {
+  ASSERT(is_thread(holder));
+  enum intr_level old_level = intr_disable();
+  lock->holder = NULL;
+  if (!thread_donation_enabled()) {
+    intr_set_level(old_level);
+    return;
+  }
+  rb_remove(&holder->priority_donation_info.held_locks, &lock->holder_elem);
+  thread_update_donated_priority(holder);
+  intr_set_level(old_level);
+}
+
+/* 
+  reader has just acquired rw for reading. the hold is recorded so that a writer can donate
+  to reader while it waits; once all of reader's THREAD_READ_HOLDS slots are in use, 
+  further holds are not recorded and receive no donation.
+*/
+void thread_hold_read(struct thread *reader, struct rwlock *rw) {
+  struct rwlock_reader *free_hold = NULL;
+  ASSERT(is_thread(reader));
+  if (!thread_donation_enabled()) {
+    return;
+  }
+  enum intr_level old_level = intr_disable();
+  for (int i = 0; i < THREAD_READ_HOLDS; i++) {
+    struct rwlock_reader *hold = &reader->priority_donation_info.read_holds[i];
+    if (hold->rw == rw) {
+      hold->depth++;
+      intr_set_level(old_level);
       return;
     }
-    if (!list_empty(donor_threads_list)) {
-      for (struct list_elem *e = list_begin(donor_threads_list); e != list_end(donor_threads_list); e = list_next(e)) {
-        struct thread *donor = list_entry(e, struct thread, priority_donation_info.elem);
-        priority = donor->priority > priority ? donor->priority : priority;
-      }
-      recipient->priority = priority;
+    if (hold->rw == NULL && free_hold == NULL) {
+      free_hold = hold;
     }
-    else {
-      recipient->priority = recipient->priority_donation_info.genesis_priority;
+  }
+  if (free_hold != NULL) {
+    free_hold->rw = rw;
+    free_hold->thread = reader;
+    free_hold->depth = 1;
+    list_push_back(&rw->reader_holds, &free_hold->elem);
+  }
+  intr_set_level(old_level);
+}
+
+/* reader is releasing its hold on rw, and loses the priority a writer donated through it */
+void thread_release_read(struct thread *reader, struct rwlock *rw) {
+  ASSERT(is_thread(reader));
+  if (!thread_donation_enabled()) {
+    return;
+  }
+  enum intr_level old_level = intr_disable();
+  for (int i = 0; i < THREAD_READ_HOLDS; i++) {
+    struct rwlock_reader *hold = &reader->priority_donation_info.read_holds[i];
+    if (hold->rw == rw) {
+      if (--hold->depth == 0) {
+        list_remove(&hold->elem);
+        hold->rw = NULL;
+        thread_update_donated_priority(reader);
+      }
+      break;
     }
   }
-  else {
+  intr_set_level(old_level);
+}
+
+/* writer, rw's writer_waiting, is about to wait for rw's readers to leave, and donates to them */
+void thread_donate_to_readers(struct thread *writer, struct rwlock *rw) {
+  ASSERT(is_thread(writer));
+  if (!thread_donation_enabled()) {
     return;
-  } 
+  }
+  enum intr_level old_level = intr_disable();
+  writer->priority_donation_info.waiting_rwlock = rw;
+  thread_update_readers(rw);
+  intr_set_level(old_level);
+}
+
+/* writer no longer waits for the readers of an rwlock */
+void thread_readers_drained(struct thread *writer) {
+  ASSERT(is_thread(writer));
+  writer->priority_donation_info.waiting_rwlock = NULL;
 }
 
 static int priority_clamp(int pri) {
@@ -847,30 +1306,94 @@ static int priority_clamp(int pri) {
 void thread_mlfqs_recalculate_priority(struct thread *current) {
   ASSERT(thread_mlfqs);
   ASSERT(current != idle_thread);
-  current->priority = priority_clamp(PRI_MAX 
+  thread_change_priority(current, priority_clamp(PRI_MAX 
     - fixed64_to_int32(fixed64_div_int32(current->mlfqs_recent_cpu, 4))
-    - current->mlfqs_nice * 2);
+    - current->nice * 2));
 }
 
-void thread_mlfqs_recalculate_recent_cpu(struct thread *current) {
+/* returns c^k for a decay factor c, by repeated squaring. */
+static fixed64 mlfqs_decay_pow(fixed64 c, int64_t k) {
+  fixed64 result = int32_to_fixed64(1);
+  while (k > 0 && result != 0) {
+    if (k & 1) {
+      result = fixed64_mul(result, c);
+    }
+    c = fixed64_mul(c, c);
+    k >>= 1;
+  }
+  return result;
+}
+
+/* Applies the once-per-second decays that current missed. Returns true if there were any. */
+bool thread_mlfqs_recalculate_recent_cpu(struct thread *current) {
   ASSERT(thread_mlfqs);
   ASSERT(current != idle_thread);
-  current->mlfqs_recent_cpu = fixed64_add_int32(
-      fixed64_mul(fixed64_div(
-        fixed64_mul_int32(mlfqs_load_avg, 2),
-        fixed64_add_int32(fixed64_mul_int32(mlfqs_load_avg, 2), 1)), current->mlfqs_recent_cpu),
-      current->mlfqs_nice);
+  int64_t missed = mlfqs_epoch - current->mlfqs_epoch;
+  if (missed == 0) {
+    return false;
+  }
+  if (missed > MLFQS_DECAY_HISTORY) {
+    /* r = c^k * r + nice * (1 + c + ... + c^(k-1)) for the k forgotten decays */
+    int64_t forgotten = missed - MLFQS_DECAY_HISTORY;
+    fixed64 c = mlfqs_decay_history[mlfqs_epoch % MLFQS_DECAY_HISTORY];
+    fixed64 ck = mlfqs_decay_pow(c, forgotten);
+    fixed64 one = int32_to_fixed64(1);
+    if (c == one) {
+      current->mlfqs_recent_cpu = fixed64_add(current->mlfqs_recent_cpu, 
+        fixed64_mul_int64(int32_to_fixed64(current->nice), forgotten));
+    }
+    else {
+      current->mlfqs_recent_cpu = fixed64_add(fixed64_mul(ck, current->mlfqs_recent_cpu),
+        fixed64_div(fixed64_mul_int32(fixed64_sub(one, ck), current->nice), fixed64_sub(one, c)));
+    }
+    missed = MLFQS_DECAY_HISTORY;
+  }
+  for (int64_t epoch = mlfqs_epoch - missed; epoch < mlfqs_epoch; epoch++) {
+    current->mlfqs_recent_cpu = fixed64_add_int32(
+      fixed64_mul(mlfqs_decay_history[epoch % MLFQS_DECAY_HISTORY], current->mlfqs_recent_cpu),
+      current->nice);
+  }
+  current->mlfqs_epoch = mlfqs_epoch;
+  return true;
 }
 
-void mlfqs_recalculate_load_avg() {
-  ASSERT(thread_mlfqs);
-  int ready_threads = thread_current() == idle_thread ? 0 : 1;
-  for (struct list_elem *e = list_begin(&ready_list); e != list_end(&ready_list); e = list_next(e)) {
-    struct thread *t = list_entry(e, struct thread, elem);
-    if (t != idle_thread) {
-      ready_threads++;
+/* 
+  under -mlfqs, applies the recent_cpu decays that t missed and recomputes its priority.
+  a blocked thread is moved to its new place among the waiters it is queued with,
+  see sema_reorder_waiter. does nothing under the other schedulers or if t is up to date.
+*/
+/* returns the number of recent_cpu decays so far. */
+int64_t thread_mlfqs_epoch(void) {
+  return mlfqs_epoch;
+}
+
+void thread_mlfqs_catch_up(struct thread *t) {
+  ASSERT(intr_get_level() == INTR_OFF);
+  if (thread_mlfqs && t != idle_thread && thread_mlfqs_recalculate_recent_cpu(t)) {
+    thread_mlfqs_recalculate_priority(t);
+  }
+}
+
+/* 
+  brings every ready thread's recent_cpu and priority up to date after a decay.
+  a thread whose priority changes moves to another level of the run queue; if it is 
+  visited again there, it is already up to date and skipped.
+*/
+static void mlfqs_decay_ready_threads(void) {
+  for (int i = PRI_MIN; i <= PRI_MAX; i++) {
+    struct list *level = &ready_queue.levels[i];
+    struct list_elem *e = list_begin(level);
+    while (e != list_end(level)) {
+      struct thread *t = list_entry(e, struct thread, elem);
+      e = list_next(e);
+      thread_mlfqs_catch_up(t);
     }
   }
+}
+
+void mlfqs_recalculate_load_avg() {
+  ASSERT(thread_mlfqs);
+  int ready_threads = (thread_current() == idle_thread ? 0 : 1) + sched->ready_cnt();
   fixed64 p = fixed64_div_int32(int32_to_fixed64(59), 60);
   fixed64 q = fixed64_div_int32(int32_to_fixed64(1), 60);
   mlfqs_load_avg = fixed64_add(
@@ -3,9 +3,12 @@
 
 #include <debug.h>
 #include <list.h>
+#include <rbtree.h>
 #include <stdint.h>
+#include "threads/malloc.h"
 #include "threads/synch.h"
 #include "threads/fixed-point.h"
+#include "devices/timer.h"
 #include "userprog/process.h"
 
 extern bool threading_started;
@@ -29,18 +32,34 @@ typedef int tid_t;
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
 
+/* Thread nice values. */
+#define NICE_MIN -20                    /* Highest claim on the CPU. */
+#define NICE_DEFAULT 0                  /* Default nice value. */
+#define NICE_MAX 20                     /* Lowest claim on the CPU. */
+
 struct thread_sleep_info {
    bool is_sleeping;
-   struct list_elem elem;
+   struct timer_event timer;
    int64_t wakeup_time;
 };
 
+/* # of rwlocks a thread can hold for reading at once and still receive donations through. */
+#define THREAD_READ_HOLDS 4
+
+/*
+  a thread's effective priority is the larger of its genesis priority and the priorities of
+  all threads waiting for locks it holds. the locks it holds are kept ordered by the highest
+  priority among their waiters, so the effective priority is found in constant time, 
+  and a change is passed on along the chain of lock holders in O(log n) per link.
+  a writer waiting for the readers of an rwlock to leave likewise donates to each of them.
+*/
 struct thread_priority_donation_info {
-   int genesis_priority;
-   struct lock *lock;
-   struct thread *recipient;
-   struct list donor_threads_list;
-   struct list_elem elem;
+   int genesis_priority;               /* Priority set by thread_set_priority(). */
+   struct lock *waiting_lock;          /* Lock this thread is waiting for, or NULL. */
+   struct rb_elem donor_elem;          /* Element in waiting_lock's donors. */
+   struct rb_tree held_locks;          /* Held locks, highest waiter priority first. */
+   struct rwlock *waiting_rwlock;      /* Rwlock whose readers this thread waits for, or NULL. */
+   struct rwlock_reader read_holds[THREAD_READ_HOLDS]; /* Rwlocks held for reading. */
 };
 
 /* A kernel thread or user process.
@@ -111,6 +130,8 @@ struct thread
 
     /* Shared between thread.c and synch.c. */
    struct list_elem elem;              /* List element. */
+   struct semaphore *waiting_sema;     /* Semaphore whose waiters hold elem, or NULL. */
+   struct semaphore_elem *cond_waiter; /* Entry in a condition's waiters, or NULL. */
 
     /* used for timer_sleep */
    struct thread_sleep_info sleep_info;
@@ -119,9 +140,16 @@ struct thread
    struct thread_priority_donation_info priority_donation_info;
 
     /* used for advanced scheduling and latency reporting. load_avg is a global value */
-   int64_t thread_ticks;
-   int mlfqs_nice;
+   int64_t start_ticks;                /* timer_ticks() at creation. */
+   int nice;
    fixed64 mlfqs_recent_cpu;
+   int64_t mlfqs_epoch;                /* # of recent_cpu decays applied to mlfqs_recent_cpu. */
+   struct thread_latency *latency;     /* Statistics for -reportlatency, or NULL. */
+   int64_t cfs_vruntime;               /* Weighted run time, for -cfs. */
+   struct rb_elem cfs_elem;            /* Element in a CFS run queue. */
+
+    /* Owned by threads/malloc.c. */
+   struct malloc_magazine magazines[MALLOC_CLASS_CNT]; /* Free blocks. */
 
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
@@ -142,7 +170,9 @@ struct thread
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
+extern bool thread_cfs;
 extern bool thread_report_latency;
+extern size_t thread_page_cache_max;
 
 void thread_init (void);
 void thread_start (void);
@@ -179,16 +209,21 @@ int thread_get_load_avg (void);
 bool thread_enter_sleep(int64_t sleep_ticks);
 bool thread_exit_sleep(struct thread *t);
 
-/* used for scheduling */
-struct thread *thread_remove_highest_priority_thread(struct list *thread_list);
-
 /* used for priority donation */
-void thread_donate_priority(struct thread *donor, struct thread *recipient, struct lock *lock);
-void thread_restore_priority(struct thread *recipient, struct lock *lock);
+rb_less_func thread_priority_more;
+void thread_donate_priority(struct thread *donor, struct lock *lock);
+void thread_hold_lock(struct thread *holder, struct lock *lock);
+void thread_restore_priority(struct thread *holder, struct lock *lock);
+void thread_hold_read(struct thread *reader, struct rwlock *rw);
+void thread_release_read(struct thread *reader, struct rwlock *rw);
+void thread_donate_to_readers(struct thread *writer, struct rwlock *rw);
+void thread_readers_drained(struct thread *writer);
 
 /* used for mlfqs */
 void thread_mlfqs_recalculate_priority(struct thread *current);
-void thread_mlfqs_recalculate_recent_cpu(struct thread *current);
+bool thread_mlfqs_recalculate_recent_cpu(struct thread *current);
+void thread_mlfqs_catch_up(struct thread *t);
+int64_t thread_mlfqs_epoch(void);
 /* since load_avg is a system wide value, we do not prefix this function with thread_ */
 void mlfqs_recalculate_load_avg();
 #endif /* threads/thread.h */
@@ -0,0 +1,228 @@
+#include "threads/trace.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/block.h"
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/tsc.h"
+#include "threads/vaddr.h"
+
+/* Kernel event tracing, enabled with "-trace" (or "-trace=PAGES"
+   to size the buffer).
+
+   Events go into a ring buffer of fixed-size records stamped with
+   rdtsc().  A writer claims a slot with an atomic increment of
+   the head index and fills it in, so recording takes no lock and
+   may happen in any context, including interrupt handlers.  Once
+   the ring is full, the oldest events are overwritten.
+
+   At shutdown the buffer is written to the scratch block device,
+   oldest event first, in the format described by struct
+   trace_header.  utils/pintos-trace turns such a dump into a
+   Chrome trace (JSON) timeline. */
+
+/* Default buffer size in pages, if "-trace" has no value. */
+#define TRACE_DEFAULT_PAGES 32
+
+#define TRACE_MAGIC "PINTRACE"
+#define TRACE_VERSION 1
+
+/* One event, as stored in the buffer and in the dump. */
+struct trace_event
+  {
+    uint64_t tsc;               /* rdtsc() when recorded. */
+    uint32_t arg;               /* Depends on TYPE; see trace.h. */
+    uint16_t tid;               /* Thread that recorded it. */
+    uint16_t type;              /* An enum trace_type. */
+  };
+
+/* First sector of a dump.  It is followed by NAME_SECTORS
+   sectors of struct trace_name, then by EVENT_CNT events packed
+   into sectors. */
+struct trace_header
+  {
+    char magic[8];              /* TRACE_MAGIC, not null-terminated. */
+    uint32_t version;           /* TRACE_VERSION. */
+    uint32_t event_size;        /* sizeof (struct trace_event). */
+    uint32_t event_cnt;         /* Number of events dumped. */
+    uint32_t lost_cnt;          /* Events overwritten or not dumped. */
+    uint64_t tsc_hz;            /* Estimated TSC frequency, or 0. */
+    uint32_t name_cnt;          /* Number of thread names. */
+    uint32_t name_sectors;      /* Sectors holding thread names. */
+  };
+
+/* Name of a thread alive at the time of the dump. */
+struct trace_name
+  {
+    int32_t tid;
+    char name[16];
+  };
+
+bool trace_enabled;
+size_t trace_pages = TRACE_DEFAULT_PAGES;
+
+static struct trace_event *trace_buf;
+static uint32_t trace_mask;             /* Capacity - 1, a power of 2 minus 1. */
+static uint32_t trace_head;             /* Total number of events claimed. */
+
+/* For estimating the TSC frequency. */
+static uint64_t start_tsc;
+static int64_t start_ticks;
+
+/* Allocates the trace buffer, if "-trace" was given.  Must be
+   called after palloc_init(). */
+void
+trace_init (void) 
+{
+  size_t capacity;
+
+  if (!trace_enabled)
+    return;
+
+  trace_buf = palloc_get_multiple (PAL_ZERO, trace_pages);
+  if (trace_buf == NULL) 
+    {
+      printf ("trace: cannot allocate %zu pages, tracing disabled\n",
+              trace_pages);
+      trace_enabled = false;
+      return;
+    }
+
+  /* Round the capacity down to a power of 2. */
+  capacity = trace_pages * PGSIZE / sizeof *trace_buf;
+  while (capacity & (capacity - 1))
+    capacity &= capacity - 1;
+  trace_mask = capacity - 1;
+
+  start_tsc = rdtsc ();
+  start_ticks = timer_ticks ();
+}
+
+/* Records an event of the given TYPE and ARG on behalf of the
+   thread with identifier TID. */
+void
+trace_record (enum trace_type type, tid_t tid, uint32_t arg) 
+{
+  struct trace_event *e;
+
+  if (trace_buf == NULL)
+    return;
+
+  e = &trace_buf[__sync_fetch_and_add (&trace_head, 1) & trace_mask];
+  e->tsc = rdtsc ();
+  e->arg = arg;
+  e->tid = tid;
+  e->type = type;
+}
+
+/* Context for collect_name(). */
+struct name_table
+  {
+    struct trace_name *names;
+    size_t cnt, max;
+  };
+
+/* thread_foreach() callback that adds T's name to AUX, a
+   struct name_table. */
+static void
+collect_name (struct thread *t, void *aux) 
+{
+  struct name_table *table = aux;
+
+  if (table->cnt < table->max) 
+    {
+      struct trace_name *n = &table->names[table->cnt++];
+      n->tid = t->tid;
+      strlcpy (n->name, t->name, sizeof n->name);
+    }
+}
+
+/* Stops tracing and writes the buffer to the scratch block
+   device, overwriting whatever it held. */
+void
+trace_dump (void) 
+{
+  static uint8_t sector[BLOCK_SECTOR_SIZE];
+  enum { EVENTS_PER_SECTOR = BLOCK_SECTOR_SIZE / sizeof (struct trace_event) };
+  struct trace_header *h = (struct trace_header *) sector;
+  struct name_table table;
+  struct block *scratch;
+  enum intr_level old_level;
+  uint32_t head, first, cnt, i;
+  block_sector_t sec, name_sectors, event_sectors;
+  int64_t ticks;
+
+  if (!trace_enabled || trace_buf == NULL)
+    return;
+  trace_enabled = false;
+
+  scratch = block_get_role (BLOCK_SCRATCH);
+  if (scratch == NULL) 
+    {
+      printf ("trace: no scratch device, trace not saved\n");
+      return;
+    }
+
+  /* Collect the names of live threads. */
+  table.names = palloc_get_page (PAL_ZERO);
+  table.cnt = 0;
+  table.max = table.names != NULL ? PGSIZE / sizeof *table.names : 0;
+  old_level = intr_disable ();
+  thread_foreach (collect_name, &table);
+  intr_set_level (old_level);
+
+  /* Keep the newest events that fit on the device. */
+  name_sectors = DIV_ROUND_UP (table.cnt * sizeof *table.names,
+                               BLOCK_SECTOR_SIZE);
+  if (block_size (scratch) < 1 + name_sectors) 
+    {
+      printf ("trace: scratch device too small, trace not saved\n");
+      palloc_free_page (table.names);
+      return;
+    }
+  event_sectors = block_size (scratch) - 1 - name_sectors;
+  head = trace_head;
+  cnt = head < trace_mask + 1 ? head : trace_mask + 1;
+  if (cnt > event_sectors * EVENTS_PER_SECTOR)
+    cnt = event_sectors * EVENTS_PER_SECTOR;
+  first = head - cnt;
+
+  /* Header. */
+  memset (sector, 0, sizeof sector);
+  memcpy (h->magic, TRACE_MAGIC, sizeof h->magic);
+  h->version = TRACE_VERSION;
+  h->event_size = sizeof (struct trace_event);
+  h->event_cnt = cnt;
+  h->lost_cnt = first;
+  ticks = timer_ticks () - start_ticks;
+  h->tsc_hz = ticks > 0 ? (rdtsc () - start_tsc) * TIMER_FREQ / ticks : 0;
+  h->name_cnt = table.cnt;
+  h->name_sectors = name_sectors;
+  block_write (scratch, 0, sector);
+  sec = 1;
+
+  /* Thread names. */
+  for (i = 0; i < name_sectors; i++)
+    block_write (scratch, sec++,
+                 (uint8_t *) table.names + i * BLOCK_SECTOR_SIZE);
+  palloc_free_page (table.names);
+
+  /* Events, oldest first. */
+  for (i = 0; i < cnt; i += EVENTS_PER_SECTOR) 
+    {
+      struct trace_event *out = (struct trace_event *) sector;
+      uint32_t j;
+
+      memset (sector, 0, sizeof sector);
+      for (j = 0; j < EVENTS_PER_SECTOR && i + j < cnt; j++)
+        out[j] = trace_buf[(first + i + j) & trace_mask];
+      block_write (scratch, sec++, sector);
+    }
+
+  printf ("trace: %"PRIu32" events saved to scratch device, %"PRIu32" lost\n",
+          cnt, first);
+}
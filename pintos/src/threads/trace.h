@@ -0,0 +1,47 @@
+#ifndef THREADS_TRACE_H
+#define THREADS_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/thread.h"
+
+/* Kernel event tracing, enabled with "-trace".  See
+   threads/trace.c. */
+
+/* Kinds of trace events, and the meaning of their argument. */
+enum trace_type
+  {
+    TRACE_SWITCH = 1,           /* Context switch: next thread's tid. */
+    TRACE_SYSCALL_ENTER,        /* System call entry: call number. */
+    TRACE_SYSCALL_EXIT,         /* System call exit: call number. */
+    TRACE_PAGE_FAULT,           /* Page fault: faulting address. */
+    TRACE_BCACHE_HIT,           /* Buffer cache hit: sector. */
+    TRACE_BCACHE_MISS,          /* Buffer cache miss: sector. */
+    TRACE_BCACHE_EVICT,         /* Buffer cache eviction: old sector. */
+    TRACE_BLOCK_SUBMIT,         /* Block I/O start: sector | TRACE_BLOCK_WRITE. */
+    TRACE_BLOCK_COMPLETE,       /* Block I/O end: sector | TRACE_BLOCK_WRITE. */
+    TRACE_LOCK_WAIT_BEGIN,      /* Blocking in lock_acquire(): lock address. */
+    TRACE_LOCK_WAIT_END         /* Acquired after blocking: lock address. */
+  };
+
+/* Set in the argument of block I/O events for writes. */
+#define TRACE_BLOCK_WRITE 0x80000000u
+
+extern bool trace_enabled;
+extern size_t trace_pages;
+
+void trace_init (void);
+void trace_record (enum trace_type, tid_t, uint32_t arg);
+void trace_dump (void);
+
+/* Records an event of the given TYPE and ARG for the running
+   thread.  Costs one well-predicted branch when tracing is
+   off. */
+static inline void
+trace_log (enum trace_type type, uint32_t arg) 
+{
+  if (trace_enabled)
+    trace_record (type, thread_current ()->tid, arg);
+}
+
+#endif /* threads/trace.h */
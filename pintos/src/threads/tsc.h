@@ -0,0 +1,18 @@
+#ifndef THREADS_TSC_H
+#define THREADS_TSC_H
+
+#include <stdint.h>
+
+/* Returns the CPU's time-stamp counter, which counts processor
+   cycles since reset.  Cheap enough to call on hot paths, but
+   only meaningful for measuring intervals on a single CPU.
+   See [IA32-v2b] "RDTSC". */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+#endif /* threads/tsc.h */
@@ -0,0 +1,271 @@
+#include "threads/workqueue.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+
+/* Deferred work.
+
+   A workqueue is a list of pending work items and a pool of
+   kernel threads that take items off the front of the list and
+   run them.  Queueing work never sleeps, so it may be done from
+   an interrupt handler, which is how delayed work is queued when
+   its timer event expires.
+
+   A work item is either idle or pending on exactly one queue.
+   It stops being pending as soon as a worker takes it, so its
+   function may queue it again.  Queueing an item that is already
+   pending has no effect.
+
+   The worker threads of a queue run at the priority it was
+   created with, which lets background work such as writeback
+   stay out of the way of foreground threads. */
+
+/* Number of workers and their priority for system_wq. */
+#define SYSTEM_WQ_WORKERS 2
+
+struct workqueue system_wq;
+
+/* A thread waiting in flush_workqueue(). */
+struct flusher
+  {
+    struct list_elem elem;
+    struct semaphore done;
+  };
+
+static thread_func worker_func;
+static timer_event_func delayed_work_timer;
+
+/* Creates system_wq.  Must be called after thread_start(). */
+void
+workqueue_init (void) 
+{
+  if (!workqueue_create (&system_wq, "events", SYSTEM_WQ_WORKERS,
+                         PRI_DEFAULT))
+    PANIC ("workqueue_init: cannot create worker threads");
+}
+
+/* Initializes WQ and starts WORKER_CNT worker threads for it at
+   the given PRIORITY, naming them after NAME, which must outlive
+   the queue.  Returns true if successful, false if not all
+   workers could be created; the queue is usable as long as at
+   least one was. */
+bool
+workqueue_create (struct workqueue *wq, const char *name, int worker_cnt,
+                  int priority) 
+{
+  int i;
+
+  ASSERT (wq != NULL);
+  ASSERT (worker_cnt > 0);
+
+  wq->name = name;
+  list_init (&wq->pending);
+  sema_init (&wq->ready, 0);
+  wq->busy = 0;
+  list_init (&wq->flushers);
+
+  for (i = 0; i < worker_cnt; i++) 
+    {
+      char thread_name[16];
+
+      snprintf (thread_name, sizeof thread_name, "%s/%d", name, i);
+      if (thread_create (thread_name, priority, worker_func, wq) == TID_ERROR)
+        return i > 0;
+    }
+  return true;
+}
+
+/* Waits until every item queued on WQ so far, and anything they
+   queue in turn, has finished running.  Must not be called by
+   one of WQ's own workers. */
+void
+flush_workqueue (struct workqueue *wq) 
+{
+  struct flusher f;
+  enum intr_level old_level;
+  bool idle;
+
+  ASSERT (!intr_context ());
+
+  sema_init (&f.done, 0);
+  old_level = intr_disable ();
+  idle = wq->busy == 0;
+  if (!idle)
+    list_push_back (&wq->flushers, &f.elem);
+  intr_set_level (old_level);
+
+  if (!idle)
+    sema_down (&f.done);
+}
+
+/* Initializes W to call FUNC(AUX) when it runs. */
+void
+work_init (struct work *w, work_func *func, void *aux) 
+{
+  ASSERT (w != NULL);
+  ASSERT (func != NULL);
+
+  w->func = func;
+  w->aux = aux;
+  w->wq = NULL;
+}
+
+/* Queues W on WQ.  Returns true if successful, false if W was
+   already pending.
+
+   This function may be called from an interrupt handler. */
+bool
+queue_work (struct workqueue *wq, struct work *w) 
+{
+  enum intr_level old_level;
+  bool queued = false;
+
+  ASSERT (wq != NULL);
+  ASSERT (w != NULL);
+
+  old_level = intr_disable ();
+  if (w->wq == NULL) 
+    {
+      w->wq = wq;
+      list_push_back (&wq->pending, &w->elem);
+      wq->busy++;
+      sema_up (&wq->ready);
+      queued = true;
+    }
+  intr_set_level (old_level);
+  return queued;
+}
+
+/* Removes W from its queue if it is pending.  Returns true if it
+   was, false if it was idle or already running.  Does not wait
+   for a running W to finish. */
+bool
+cancel_work (struct work *w) 
+{
+  struct workqueue *wq;
+  enum intr_level old_level;
+
+  ASSERT (w != NULL);
+
+  old_level = intr_disable ();
+  wq = w->wq;
+  if (wq != NULL) 
+    {
+      list_remove (&w->elem);
+      w->wq = NULL;
+      wq->busy--;
+
+      /* Take back W's count.  If a worker already has it, that
+         worker finds the queue empty and goes back to sleep. */
+      sema_try_down (&wq->ready);
+    }
+  intr_set_level (old_level);
+  return wq != NULL;
+}
+
+/* Returns true if W is queued and has not started running. */
+bool
+work_pending (const struct work *w) 
+{
+  return w->wq != NULL;
+}
+
+/* Initializes DW to call FUNC(AUX) when it runs. */
+void
+delayed_work_init (struct delayed_work *dw, work_func *func, void *aux) 
+{
+  ASSERT (dw != NULL);
+
+  work_init (&dw->work, func, aux);
+  timer_event_init (&dw->timer, delayed_work_timer, dw);
+  dw->wq = NULL;
+}
+
+/* Queues DW on WQ once TICKS timer ticks have passed, or right
+   away if TICKS is 0 or less.  Returns true if successful, false
+   if DW was already waiting for its timer or pending.
+
+   This function may be called from an interrupt handler. */
+bool
+queue_delayed_work (struct workqueue *wq, struct delayed_work *dw,
+                    int64_t ticks) 
+{
+  enum intr_level old_level;
+  bool queued = false;
+
+  ASSERT (wq != NULL);
+  ASSERT (dw != NULL);
+
+  if (ticks <= 0)
+    return queue_work (wq, &dw->work);
+
+  old_level = intr_disable ();
+  if (!dw->timer.armed && !work_pending (&dw->work)) 
+    {
+      dw->wq = wq;
+      timer_event_arm (&dw->timer, timer_ticks () + ticks);
+      queued = true;
+    }
+  intr_set_level (old_level);
+  return queued;
+}
+
+/* Stops DW from running, whether it is still waiting for its
+   timer or already pending.  Returns true if it was stopped,
+   false if it was idle or already running. */
+bool
+cancel_delayed_work (struct delayed_work *dw) 
+{
+  ASSERT (dw != NULL);
+
+  return timer_event_cancel (&dw->timer) || cancel_work (&dw->work);
+}
+
+/* Timer callback for delayed work DW_: queues it. */
+static void
+delayed_work_timer (void *dw_) 
+{
+  struct delayed_work *dw = dw_;
+
+  queue_work (dw->wq, &dw->work);
+}
+
+/* Worker thread body: runs work from WQ_, a struct workqueue,
+   forever. */
+static void
+worker_func (void *wq_) 
+{
+  struct workqueue *wq = wq_;
+
+  for (;;) 
+    {
+      enum intr_level old_level;
+      struct work *w = NULL;
+
+      sema_down (&wq->ready);
+
+      old_level = intr_disable ();
+      if (!list_empty (&wq->pending)) 
+        {
+          w = list_entry (list_pop_front (&wq->pending), struct work, elem);
+          w->wq = NULL;
+        }
+      intr_set_level (old_level);
+
+      if (w == NULL)
+        continue;
+      w->func (w->aux);
+
+      /* Wake up flushers once the queue drains. */
+      old_level = intr_disable ();
+      if (--wq->busy == 0)
+        while (!list_empty (&wq->flushers)) 
+          {
+            struct flusher *f = list_entry (list_pop_front (&wq->flushers),
+                                            struct flusher, elem);
+            sema_up (&f->done);
+          }
+      intr_set_level (old_level);
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef THREADS_WORKQUEUE_H
+#define THREADS_WORKQUEUE_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "devices/timer.h"
+#include "threads/synch.h"
+
+/* Deferred work, run by a pool of kernel worker threads.
+   See threads/workqueue.c. */
+
+typedef void work_func (void *aux);
+
+/* An item of work. */
+struct work
+  {
+    struct list_elem elem;      /* Element in a workqueue's pending list. */
+    work_func *func;            /* Function to run. */
+    void *aux;                  /* Argument to FUNC. */
+    struct workqueue *wq;       /* Queue it is pending on, or NULL. */
+  };
+
+/* Work that is queued after a delay. */
+struct delayed_work
+  {
+    struct work work;           /* The work itself. */
+    struct timer_event timer;   /* Queues WORK when it expires. */
+    struct workqueue *wq;       /* Queue to use when TIMER expires. */
+  };
+
+/* A queue of work and the threads that run it.  Its members are
+   accessed with interrupts off. */
+struct workqueue
+  {
+    const char *name;           /* Prefix of worker thread names. */
+    struct list pending;        /* Queued work, oldest first. */
+    struct semaphore ready;     /* One up per queued item. */
+    unsigned busy;              /* Items queued or running. */
+    struct list flushers;       /* Waiters in flush_workqueue(). */
+  };
+
+/* Shared queue for work that needs no dedicated workers. */
+extern struct workqueue system_wq;
+
+void workqueue_init (void);
+bool workqueue_create (struct workqueue *, const char *name,
+                       int worker_cnt, int priority);
+void flush_workqueue (struct workqueue *);
+
+void work_init (struct work *, work_func *, void *aux);
+bool queue_work (struct workqueue *, struct work *);
+bool cancel_work (struct work *);
+bool work_pending (const struct work *);
+
+void delayed_work_init (struct delayed_work *, work_func *, void *aux);
+bool queue_delayed_work (struct workqueue *, struct delayed_work *,
+                         int64_t ticks);
+bool cancel_delayed_work (struct delayed_work *);
+
+#endif /* threads/workqueue.h */
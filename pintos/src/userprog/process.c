@@ -19,12 +19,14 @@
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "threads/synch.h"
 #include "userprog/usermem.h"
 #include "vm/vpage.h"
 #include "vm/swap.h"
 
 static struct pid_allocator pid_allocator;
+static struct kmem_cache process_info_cache;
 /* used to prevent race between exec/wait/exit */
 static struct lock process_lock;
 
@@ -139,7 +141,7 @@ struct process_info *get_process_info(pid_t pid) {
 */
 struct process_info *process_info_allocate(struct semaphore *sema, struct process_info *parent_pi) {
   struct process_info *new;
-  if ((new = malloc(sizeof(struct process_info))) == NULL) {
+  if ((new = kmem_cache_alloc(&process_info_cache)) == NULL) {
     return NULL;
   }
   new->pid = pid_allocate();
@@ -150,6 +152,7 @@ struct process_info *process_info_allocate(struct semaphore *sema, struct proces
   new->parent_pi = parent_pi;
   new->is_critical = false;
   new->exe_file = NULL;
+  new->vpages = NULL;
   if (parent_pi == NULL) {
     new->cwd = dir_open_root();
   }
@@ -186,7 +189,7 @@ void process_info_release(struct process_info *pi) {
       //ASSERT(child_pi->parent_pi == pi);
       child_pi->parent_pi = NULL;
   }
-  free(pi);
+  kmem_cache_free(&process_info_cache, pi);
 }
 
 void process_info_set_exit_code(struct process_info *info, int exit_code) {
@@ -197,6 +200,7 @@ void process_init() {
   lock_init(&pid_allocator.pid_lock);
   pid_allocator.last_pid = 1;
   lock_init(&process_lock);
+  kmem_cache_init(&process_info_cache, "process_info", sizeof(struct process_info), 0, NULL);
 }
 
 /* Starts a new thread running a user program loaded from
@@ -379,7 +383,7 @@ process_exit (void)
 
     /* free all vapge entries */
     {
-      vpage_info_release_all(pi->pid);
+      vpage_info_release_all(pi);
     }
 
     /* free all user_file objects */
@@ -826,7 +830,7 @@ load_segment (struct process_info *pi, struct file *file, off_t ofs, uint8_t *up
       size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
       /* Add the page to the process's address space. */
-      if (!vpage_info_lazy_allocate(upage, file, ofs, page_read_bytes, pi->pid, writable)) 
+      if (!vpage_info_lazy_allocate(upage, file, ofs, page_read_bytes, pi, writable, false)) 
       {
         return false; 
       }
@@ -884,21 +888,16 @@ setup_stack (struct process_info *pi, void **esp)
 {
   uint8_t *kpage, *upage;
   struct vpage_info *vpi_stack;
-  pid_t pid;
 
   upage = (uint8_t *)PHYS_BASE - PGSIZE;
-  pid = pi->pid;
 
-  vpi_stack = vpage_info_inmem_allocate(upage, &kpage, pid, true);
+  /* on failure nothing was allocated, so there is nothing to free */
+  vpi_stack = vpage_info_inmem_allocate(upage, &kpage, pi, true);
   if (!vpi_stack) {
-    goto fail;
+    return false;
   }
   *esp = upage + PGSIZE;
   return true;
-fail:
-  palloc_free_page(kpage);
-fail_nofree:
-  return false;
 }
 
 /* Adds a mapping from user virtual address UPAGE to kernel
@@ -55,6 +55,9 @@ struct process_info {
     /* related to mid management */
     struct list mmap_entries_list;
 
+    /* supplemental page table (vm/vpage.h), NULL until the first page is added */
+    struct vpage_table *vpages;
+
     /* used for synch */
     struct lock lock;
 
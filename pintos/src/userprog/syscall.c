@@ -5,7 +5,11 @@
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "threads/synch.h"
+#include "threads/lockstat.h"
+#include "threads/memstat.h"
+#include "threads/trace.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "devices/shutdown.h"
 #include "userprog/usermem.h"
 #include "filesys/file.h"
@@ -28,6 +32,8 @@ static char *strdup_user(const char *user_string, bool *fault);
 static struct mmap_entry *mmap_entry_append(struct file *file, void *data);
 static struct mmap_entry *mmap_entry_get(mid_t mid);
 
+static struct kmem_cache user_file_cache;
+
 static mid_t mid_allocate() {
   return ++thread_current()->mid_counter;
 }
@@ -43,7 +49,7 @@ static bool user_file_less(const struct list_elem *e1, const struct list_elem *e
 }
 
 bool init_stdin(struct process_info *pi) {
-  struct user_file *f = malloc(sizeof(struct user_file));
+  struct user_file *f = kmem_cache_alloc(&user_file_cache);
   if (f == NULL) {
     return false;
   }
@@ -55,7 +61,7 @@ bool init_stdin(struct process_info *pi) {
 }
 
 bool init_stdout(struct process_info *pi) {
-  struct user_file *f = malloc(sizeof(struct user_file));
+  struct user_file *f = kmem_cache_alloc(&user_file_cache);
   if (f == NULL) {
     return false;
   }
@@ -68,7 +74,7 @@ bool init_stdout(struct process_info *pi) {
 
 /* allocates fd and user_file structure for dir, and appends it to pi's list */
 static bool append_dir(struct process_info *pi, struct dir *dir, int *fd) {
-  struct user_file *f = malloc(sizeof(struct user_file));
+  struct user_file *f = kmem_cache_alloc(&user_file_cache);
   if (f == NULL) {
     return false;
   }
@@ -82,7 +88,7 @@ static bool append_dir(struct process_info *pi, struct dir *dir, int *fd) {
 
 /* allocates fd and user_file structure for file, and appends it to pi's list */
 static bool append_file(struct process_info *pi, struct file *file, int *fd) {
-  struct user_file *f = malloc(sizeof(struct user_file));
+  struct user_file *f = kmem_cache_alloc(&user_file_cache);
   if (f == NULL) {
     return false;
   }
@@ -144,20 +150,18 @@ static struct mmap_entry *mmap_entry_append(struct file *file, void *upage) {
   me->length = file_length(file);
   me->page_cnt = (size_t)pg_round_up(me->length) / PGSIZE;
   me->uaddr = upage;
-  me->dirty = false;
   // what about the executable file, can this be mapped as writable? hmmm...
   rem_length = me->length;
   cur_offset = 0;
   for (int i = 0; i < me->page_cnt; i++) {
     cur_length = rem_length > PGSIZE ? PGSIZE : rem_length;
-    struct file *file_copy = file_reopen(file);
-    // initially, set permission to read-only
-    if (!file_copy || 
-      !vpage_info_lazy_allocate((char *)upage + PGSIZE*i, file_copy, cur_offset, cur_length, thread_current()->process_info->pid, false)) 
+    // dirty pages are found by the hardware dirty bit and written back to the
+    // file when evicted or unmapped (vm/vpage.c)
+    if (!vpage_info_lazy_allocate((char *)upage + PGSIZE*i, file, cur_offset, cur_length, thread_current()->process_info, true, true)) 
       {
         free(me);
         for (int j = 0; j < i; j++) {
-          vpage_info_find_and_release((char *)upage + PGSIZE*j, thread_current()->process_info->pid);
+          vpage_info_find_and_release((char *)upage + PGSIZE*j, thread_current()->process_info);
       }
       return NULL;
     }
@@ -192,32 +196,14 @@ struct mmap_entry *mmap_entry_get_by_addr(void *uaddr) {
 }
 
 void mmap_entry_release(struct mmap_entry *me) {
-  struct vpage_info *vpi = NULL;
-  int i;
-  // optimize: if vpi is lazy, don't do writeback
-  // this need not be locked because transition from lazy to inmem can only be triggered by the current process
-  for (i = 0; i < me->page_cnt; i++) {
-    struct vpage_info *vpi_ = NULL;
-    if ((vpi_ = vpage_info_find((char*)me->uaddr + PGSIZE*i, thread_current()->process_info->pid)) == NULL) {
-      NOT_REACHED();
-    }
-    if (vpi_->status != VPAGE_LAZY) {
-      break;
-    }
-  }
-  if (me->dirty) {
-    fault_region_enter();
-    file_write(me->file, me->uaddr, me->length);
-    fault_region_exit();
+  // release vpage_info. this writes dirty pages that are still in memory back
+  // to the file; pages evicted earlier were written back then.
+  for (int i = 0; i < me->page_cnt; i++) {
+    vpage_info_find_and_release((char*)me->uaddr + PGSIZE*i, thread_current()->process_info);
   }
-  
+
   // close file
   file_close(me->file);
-
-  // release vpage_info
-  for (int i = 0; i < me->page_cnt; i++) {
-    vpage_info_find_and_release((char*)me->uaddr + PGSIZE*i, thread_current()->process_info->pid);
-  }
   list_remove(&me->elem);  
 }
 
@@ -235,7 +221,7 @@ void user_file_release(struct user_file *uf) {
       break;
     }
   }
-  free(uf);
+  kmem_cache_free(&user_file_cache, uf);
 }
 
 
@@ -269,6 +255,8 @@ void
 syscall_init (void) 
 {
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
+  kmem_cache_init (&user_file_cache, "user_file", sizeof (struct user_file),
+                   0, NULL);
 }
 
 int
@@ -770,6 +758,15 @@ done:
   return return_value;
 }
 
+bool sys_memstat(struct memstat *ms) {
+  struct memstat copy;
+  memstat_get(&copy);
+  if (copy_to_user(ms, &copy, sizeof(copy)) == -1) {
+    sys_exit(-1);
+  }
+  return true;
+}
+
 int sys_inumber(int fd) {
   struct user_file *uf;
   int return_value;
@@ -806,6 +803,7 @@ syscall_handler (struct intr_frame *f)
   memcpy(&args_copy, args, sizeof(args_copy));
   fault_region_exit();
 
+  trace_log(TRACE_SYSCALL_ENTER, args_copy.syscall_nr);
   switch (args_copy.syscall_nr) {
     case SYS_HALT: {
       shutdown_power_off();
@@ -899,9 +897,18 @@ syscall_handler (struct intr_frame *f)
       f->eax = sys_inumber((int)args_copy.syscall_args[0]);
       break;
     }
+    case SYS_LOCKSTAT: {
+      f->eax = lockstat_print();
+      break;
+    }
+    case SYS_MEMSTAT: {
+      f->eax = sys_memstat((struct memstat *)args_copy.syscall_args[0]);
+      break;
+    }
     default: {
       printf("unimplemented syscall %d\n", args_copy.syscall_nr);
       break;
     }
   }
+  trace_log(TRACE_SYSCALL_EXIT, args_copy.syscall_nr);
 }
@@ -2,6 +2,7 @@
 #define USERPROG_SYSCALL_H
 
 #include "process.h"
+#include <memstat.h>
 #include <stdint.h>
 
 struct syscall_arguments {
@@ -37,7 +38,6 @@ struct mmap_entry {
     void *uaddr;
     size_t length;
     size_t page_cnt;
-    bool dirty;
     struct list_elem elem;
 };
 
@@ -67,6 +67,7 @@ int sys_mkdir(const char *path);
 int sys_readdir(int fd, char *name);
 int sys_isdir(int fd);
 int sys_inumber(int fd);
+bool sys_memstat(struct memstat *ms);
 void mmap_entry_allocate();
 struct mmap_entry *mmap_entry_get_by_addr(void *uaddr);
 void mmap_entry_release(struct mmap_entry *);
@@ -0,0 +1,69 @@
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/frame.h"
+#include "vm/vpage.h"
+
+// the frame table has one entry per frame in the user pool, recording which
+// vpage_info (if any) the frame currently holds. eviction runs a clock hand
+// over it: a frame whose page was accessed since the hand last passed gets its
+// accessed bit cleared and a second chance, and the first frame found with the
+// bit clear is the victim. every pass clears the bits it skips, so the hand
+// finds a victim within two sweeps, and in practice after a few frames.
+// synchronization (vm_lock) must be guaranteed by the caller.
+
+struct frame {
+    struct vpage_info *vpi;     // page held in this frame, or NULL
+};
+
+static struct frame *frames;
+static uint8_t *frame_base;
+static size_t frame_cnt;
+static size_t clock_hand;
+
+void frame_init(void) {
+    void *base;
+    size_t table_pages;
+    palloc_get_user_range(&base, &frame_cnt);
+    frame_base = base;
+    table_pages = DIV_ROUND_UP(frame_cnt * sizeof(struct frame), PGSIZE);
+    frames = palloc_get_multiple(PAL_ASSERT|PAL_ZERO, table_pages);
+    clock_hand = 0;
+}
+
+static struct frame *frame_lookup(void *paddr) {
+    size_t idx = pg_no(paddr) - pg_no(frame_base);
+    ASSERT(pg_ofs(paddr) == 0);
+    ASSERT(idx < frame_cnt);
+    return &frames[idx];
+}
+
+// records that PADDR holds VPI's page, or nothing if VPI is NULL
+void frame_set_owner(void *paddr, struct vpage_info *vpi) {
+    frame_lookup(paddr)->vpi = vpi;
+}
+
+// advances the clock hand to the next frame to evict and returns its page, or
+// NULL if no frame holds a page. the page stays in memory; the caller evicts it.
+struct vpage_info *frame_pick_victim(void) {
+    size_t n;
+    for (n = 0; n < 2 * frame_cnt; n++) {
+        struct vpage_info *vpi = frames[clock_hand].vpi;
+        if (++clock_hand == frame_cnt) {
+            clock_hand = 0;
+        }
+        if (vpi == NULL) {
+            continue;
+        }
+        ASSERT(vpi->status == VPAGE_INMEM);
+        if (pagedir_is_accessed(vpi->backend.inmem.pagedir, vpi->uaddr)) {
+            pagedir_set_accessed(vpi->backend.inmem.pagedir, vpi->uaddr, false);
+            continue;
+        }
+        return vpi;
+    }
+    return NULL;
+}
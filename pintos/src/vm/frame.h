@@ -0,0 +1,7 @@
+#include <stddef.h>
+
+struct vpage_info;
+
+void frame_init(void);
+void frame_set_owner(void *paddr, struct vpage_info *vpi);
+struct vpage_info *frame_pick_victim(void);
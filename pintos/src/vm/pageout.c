@@ -0,0 +1,97 @@
+#include <debug.h>
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "vm/pageout.h"
+#include "vm/vpage.h"
+
+// the page-out daemon keeps the number of free user frames between two
+// watermarks, so that page faults usually find a free frame instead of
+// evicting and waiting for a swap write themselves. when a fault leaves fewer
+// than pageout_low_wm frames free, the daemon is woken and evicts pages in
+// batches until pageout_high_wm frames are free, then sleeps again. faults
+// still evict by themselves if the pool runs dry before the daemon catches up.
+
+size_t pageout_low_wm;
+size_t pageout_high_wm;
+
+static struct semaphore pageout_wake;
+static bool pageout_running;            // woken and not yet back to sleep
+
+// pages evicted per call into vpage_reclaim()
+#define PAGEOUT_BATCH 32
+// above the processes that fill memory, so that the daemon keeps ahead of them
+#define PAGEOUT_PRI (PRI_DEFAULT + 10)
+
+static void pageout_daemon(void *aux);
+
+// starts the page-out daemon. watermarks not given on the command line
+// default to 1/64 of the user pool (at least 8 frames) and twice that. the
+// high watermark is capped at half the pool.
+void pageout_init(void) {
+    void *base;
+    size_t frame_cnt;
+    palloc_get_user_range(&base, &frame_cnt);
+    if (pageout_low_wm == 0) {
+        pageout_low_wm = frame_cnt / 64 > 8 ? frame_cnt / 64 : 8;
+    }
+    if (pageout_high_wm <= pageout_low_wm) {
+        pageout_high_wm = 2 * pageout_low_wm;
+    }
+    if (pageout_high_wm > frame_cnt / 2) {
+        pageout_high_wm = frame_cnt / 2;
+        if (pageout_low_wm > pageout_high_wm / 2) {
+            pageout_low_wm = pageout_high_wm / 2;
+        }
+    }
+    sema_init(&pageout_wake, 0);
+    pageout_running = false;
+    if (thread_create("pageout", PAGEOUT_PRI, pageout_daemon, NULL) == TID_ERROR) {
+        PANIC("pageout_init: cannot create daemon thread");
+    }
+}
+
+// wakes the daemon if free user frames are below the low watermark.
+void pageout_check(void) {
+    enum intr_level old_level;
+    if (palloc_free_cnt(PAL_USER) >= pageout_low_wm) {
+        return;
+    }
+    old_level = intr_disable();
+    if (!pageout_running) {
+        pageout_running = true;
+        sema_up(&pageout_wake);
+    }
+    intr_set_level(old_level);
+}
+
+static void pageout_daemon(void *aux UNUSED) {
+    enum intr_level old_level;
+    bool stalled;
+    // -mlfqs and -cfs schedule by nice, not by the priority the daemon was
+    // created with
+    if (thread_mlfqs || thread_cfs) {
+        thread_set_nice(NICE_MIN);
+    }
+    for (;;) {
+        sema_down(&pageout_wake);
+        stalled = false;
+        while (palloc_free_cnt(PAL_USER) < pageout_high_wm) {
+            if (vpage_reclaim(PAGEOUT_BATCH) == 0) {
+                stalled = true;
+                break;
+            }
+        }
+        // a pageout_check() that ran after the loop above saw pageout_running
+        // still set and did not wake us, so clear the flag and look again in
+        // one step
+        old_level = intr_disable();
+        pageout_running = false;
+        if (!stalled && palloc_free_cnt(PAL_USER) < pageout_low_wm) {
+            pageout_running = true;
+            sema_up(&pageout_wake);
+        }
+        intr_set_level(old_level);
+    }
+}
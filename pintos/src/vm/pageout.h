@@ -0,0 +1,8 @@
+#include <stddef.h>
+
+// -pageout-low, -pageout-high: free user frame watermarks, or 0 for defaults
+extern size_t pageout_low_wm;
+extern size_t pageout_high_wm;
+
+void pageout_init(void);
+void pageout_check(void);
@@ -1,14 +1,40 @@
 #include <debug.h>
+#include <inttypes.h>
 #include <stdint.h>
+#include <stdio.h>
 #include "devices/block.h"
+#include "devices/timer.h"
 #include "threads/synch.h"
+#include "threads/tsc.h"
 #include "threads/vaddr.h"
 #include "vm/swap.h"
 
+// swap space is divided into page-sized slots, tracked by a bitmap with a
+// maintained free count, so a full swap device is detected without counting,
+// and a next-fit cursor, so allocation continues where the last one stopped
+// instead of rescanning the used slots at the front of the map.
+// page-out takes a batch of pages and puts them in consecutive slots, writing
+// each run of pages that is also contiguous in memory with one multi-sector
+// request. swap_lock only covers slot allocation and statistics; the I/O
+// itself runs without it.
+
+#define SECTORS_PER_SLOT (PGSIZE / BLOCK_SECTOR_SIZE)
+
 static struct block *swap_block;
 static struct lock swap_lock;
-static struct bitmap *swap_free_map;
-size_t swap_free_map_size;
+static struct bitmap *slot_map;     // true if the slot is in use
+static size_t slot_cnt;
+static size_t free_cnt;             // false bits in slot_map
+static size_t cursor;               // where the next search starts
+
+// statistics
+static uint64_t pages_out, pages_in;
+static uint64_t write_cnt;          // write requests issued
+static uint64_t out_cycles, in_cycles;
+static uint64_t start_tsc;
+static int64_t start_ticks;
+
+static size_t slot_alloc(size_t *cnt);
 
 void swap_init() {
     lock_init(&swap_lock);
@@ -16,43 +42,122 @@ void swap_init() {
     if (swap_block == NULL) {
         ASSERT(0);
     }
-    swap_free_map_size = block_size(swap_block);
-    swap_free_map = bitmap_create(swap_free_map_size);
-}
-
-void swap_in(size_t swap_idx, void *paddr_) {
-    uint8_t *paddr = (uint8_t *)paddr_;
-    lock_acquire(&swap_lock);
-    bitmap_set_multiple(swap_free_map, swap_idx, PGSIZE/BLOCK_SECTOR_SIZE, false);
-    for (size_t i = 0; i < PGSIZE/BLOCK_SECTOR_SIZE; i++) {
-        block_read(swap_block, swap_idx + i, &paddr[i*BLOCK_SECTOR_SIZE]);
+    slot_cnt = block_size(swap_block) / SECTORS_PER_SLOT;
+    slot_map = bitmap_create(slot_cnt);
+    if (slot_map == NULL) {
+        PANIC("swap_init: cannot allocate slot map");
     }
-done:
-    lock_release(&swap_lock);
+    free_cnt = slot_cnt;
+    cursor = 0;
+    start_tsc = rdtsc();
+    start_ticks = timer_ticks();
 }
 
-int swap_out(void *paddr_) {
-    uint8_t *paddr = (uint8_t *)paddr_;
-    size_t swap_idx;
-    lock_acquire(&swap_lock);
-    if (bitmap_count(swap_free_map, 0, swap_free_map_size, false) < PGSIZE/BLOCK_SECTOR_SIZE) {
-        NOT_REACHED();
-        goto done;
+// allocates a run of up to *CNT consecutive free slots and returns the first,
+// storing the run's length in *CNT. the run is as long as possible, halving
+// *CNT until a fit is found.
+// swap_lock must be held.
+static size_t slot_alloc(size_t *cnt) {
+    size_t slot;
+    if (free_cnt == 0) {
+        PANIC("swap_out: out of swap space");
     }
-    if ((swap_idx = bitmap_scan_and_flip(swap_free_map, 0, PGSIZE/BLOCK_SECTOR_SIZE, false)) == BITMAP_ERROR) {
-        NOT_REACHED();
-        goto done;
+    if (*cnt > free_cnt) {
+        *cnt = free_cnt;
     }
-    for (size_t i = 0; i < PGSIZE/BLOCK_SECTOR_SIZE; i++) {
-        block_write(swap_block, swap_idx + i, &paddr[i*BLOCK_SECTOR_SIZE]);
+    for (;;) {
+        slot = bitmap_scan(slot_map, cursor, *cnt, false);
+        if (slot == BITMAP_ERROR && cursor > 0) {
+            slot = bitmap_scan(slot_map, 0, *cnt, false);
+        }
+        if (slot != BITMAP_ERROR) {
+            break;
+        }
+        ASSERT(*cnt > 1);
+        *cnt /= 2;
     }
-done:
+    bitmap_set_multiple(slot_map, slot, *cnt, true);
+    free_cnt -= *cnt;
+    cursor = slot + *cnt < slot_cnt ? slot + *cnt : 0;
+    return slot;
+}
+
+// reads slot SWAP_IDX into PADDR and frees the slot.
+void swap_in(size_t swap_idx, void *paddr) {
+    uint64_t start = rdtsc();
+    block_read_multiple(swap_block, swap_idx * SECTORS_PER_SLOT, SECTORS_PER_SLOT, paddr);
+    lock_acquire(&swap_lock);
+    ASSERT(bitmap_test(slot_map, swap_idx));
+    bitmap_reset(slot_map, swap_idx);
+    free_cnt++;
+    pages_in++;
+    in_cycles += rdtsc() - start;
     lock_release(&swap_lock);
-    return swap_idx;
+}
+
+// writes the CNT pages in PAGES to swap, storing the slot that holds each one
+// in SLOTS. panics if swap is full.
+void swap_out(void *pages[], size_t cnt, size_t slots[]) {
+    size_t done = 0;
+    while (done < cnt) {
+        size_t run = cnt - done, slot, i, j, requests = 0;
+        uint64_t start;
+
+        lock_acquire(&swap_lock);
+        slot = slot_alloc(&run);
+        lock_release(&swap_lock);
+
+        start = rdtsc();
+        for (i = 0; i < run; i = j) {
+            // extend the request over pages that follow each other in memory
+            for (j = i + 1; j < run; j++) {
+                if ((uint8_t *)pages[done + j] != (uint8_t *)pages[done + j - 1] + PGSIZE) {
+                    break;
+                }
+            }
+            block_write_multiple(swap_block, (slot + i) * SECTORS_PER_SLOT,
+                                 (j - i) * SECTORS_PER_SLOT, pages[done + i]);
+            requests++;
+        }
+        for (i = 0; i < run; i++) {
+            slots[done + i] = slot + i;
+        }
+
+        lock_acquire(&swap_lock);
+        pages_out += run;
+        write_cnt += requests;
+        out_cycles += rdtsc() - start;
+        lock_release(&swap_lock);
+        done += run;
+    }
 }
 
 void swap_free(uint32_t swap_idx) {
     lock_acquire(&swap_lock);
-    bitmap_set_multiple(swap_free_map, swap_idx, PGSIZE/BLOCK_SECTOR_SIZE, false);
+    ASSERT(bitmap_test(slot_map, swap_idx));
+    bitmap_reset(slot_map, swap_idx);
+    free_cnt++;
     lock_release(&swap_lock);
-}
\ No newline at end of file
+}
+
+// returns the throughput of moving PAGES pages in CYCLES cycles, in kB/s,
+// given a TSC running at HZ.
+static uint64_t throughput(uint64_t pages, uint64_t cycles, uint64_t hz) {
+    return cycles > 0 ? pages * (PGSIZE / 1024) * hz / cycles : 0;
+}
+
+// prints swap traffic and the throughput of swap I/O, measured from request
+// submission to completion.
+void swap_print_stats(void) {
+    int64_t ticks;
+    uint64_t hz;
+    if (swap_block == NULL) {
+        return;
+    }
+    ticks = timer_elapsed(start_ticks);
+    hz = ticks > 0 ? (rdtsc() - start_tsc) * TIMER_FREQ / ticks : 0;
+    printf("Swap: %"PRIu64" pages out in %"PRIu64" writes, %"PRIu64" pages in, "
+           "%zu of %zu slots free\n", pages_out, write_cnt, pages_in, free_cnt, slot_cnt);
+    printf("Swap throughput: %"PRIu64" kB/s out, %"PRIu64" kB/s in\n",
+           throughput(pages_out, out_cycles, hz), throughput(pages_in, in_cycles, hz));
+}
@@ -1,7 +1,9 @@
 #include <bitmap.h>
+#include <stddef.h>
 
 
 void swap_init();
 void swap_in(size_t swap_idx, void *paddr);
-int swap_out(void *paddr);
-void swap_free(uint32_t swap_idx);
\ No newline at end of file
+void swap_out(void *pages[], size_t cnt, size_t slots[]);
+void swap_free(uint32_t swap_idx);
+void swap_print_stats(void);
@@ -2,12 +2,16 @@
 #include "userprog/syscall.h"
 #include "userprog/exception.h"
 #include "vm/vm.h"
+#include "vm/frame.h"
+#include "vm/pageout.h"
 #include "vm/vpage.h"
 #include "vm/swap.h"
 
 void vm_init() {
     vpage_init();
+    frame_init();
     swap_init();
+    pageout_init();
 }
 
 void vm_handle_user_fault(void *uaddr, struct intr_frame *f) {
@@ -17,7 +21,7 @@ void vm_handle_user_fault(void *uaddr, struct intr_frame *f) {
     uint8_t *stack_ptr = f->esp, *fault_ptr = uaddr, *cur_page, *end_page;
     struct vpage_info *new_vpis[STACK_MAX_GROWTH_PAGES] = {0,};
     int i = 0;
-    pid_t pid = thread_current()->process_info->pid;
+    struct process_info *pi = thread_current()->process_info;
     if (stack_ptr - STACK_EXPANSION_RNG <= fault_ptr && fault_ptr <= stack_ptr + STACK_EXPANSION_RNG) {
         cur_page = pg_round_down(fault_ptr);
         end_page = (uint8_t *)(PHYS_BASE - PGSIZE);
@@ -26,15 +30,15 @@ void vm_handle_user_fault(void *uaddr, struct intr_frame *f) {
             if (i >= STACK_MAX_GROWTH_PAGES) {
                 goto oom;
             }
-            if (vpage_info_find(cur_page, pid)) {
+            if (vpage_info_find(cur_page, pi)) {
                 cur_page += PGSIZE;
                 continue;
             }
             else {
-                if (!(new_vpis[i] = vpage_info_lazy_allocate(cur_page, NULL, 0, 0, pid, true))) {
+                if (!(new_vpis[i] = vpage_info_lazy_allocate(cur_page, NULL, 0, 0, pi, true, false))) {
                     for (int j = 0; j < i; j++) {
                         if (new_vpis[j]) {
-                            vpage_info_release(new_vpis[j]);
+                            vpage_info_release(new_vpis[j], pi);
                         }   
                     }
                     goto oom;
@@ -45,19 +49,6 @@ void vm_handle_user_fault(void *uaddr, struct intr_frame *f) {
         }   
     }
 
-    // handle mmap dirty
-    struct mmap_entry *me;
-    if ((me = mmap_entry_get_by_addr(uaddr)) && f->error_code & PF_W) {
-        me->dirty = true;
-        void *upage = pg_round_down(uaddr);
-        bool inmem;
-        vpage_info_set_writable(upage, pid, true, &inmem);
-        // for in-memory vpages, this fault handler must return so that the second fault does not fault
-        if (inmem) {
-            return;
-        }
-    }
-
     enum user_fault_type ty = vpage_handle_user_fault(uaddr);
     switch (ty) {
         case UFAULT_KILL: {
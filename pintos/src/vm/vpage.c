@@ -1,82 +1,226 @@
 #include <string.h>
 #include "threads/palloc.h"
-#include "threads/malloc.h"
+#include "threads/pte.h"
+#include "threads/slab.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
-#include "devices/timer.h"
 #include "userprog/process.h"
 #include "userprog/pagedir.h"
 #include "userprog/exception.h"
 #include "userprog/syscall.h"
+#include "vm/frame.h"
+#include "vm/pageout.h"
 #include "vm/swap.h"
 #include "vm/vpage.h"
 #include "filesys/file.h"
 
-static struct hash vpage_info_map;
+// pages evicted together
+#define EVICT_CLUSTER 8
+
 static struct lock vm_lock;
+static struct condition pageout_done;   // signaled when evict_pages() finishes
+static size_t pageout_cnt;              // evict_pages() calls writing pages
+
+// eviction statistics
+static unsigned long long dropped_cnt;      // clean pages dropped
+static unsigned long long written_cnt;      // dirty pages written back to their file
+static unsigned long long swapped_cnt;      // pages written to swap
 
-static int vpage_hash(struct hash_elem *);
-static bool vpage_less(struct hash_elem *, struct hash_elem *);
-static void *evict_page();
-static void vpage_info_inmem_to_swap(struct vpage_info *vpi);
+static struct kmem_cache vpage_info_cache;
+
+static struct vpage_info **vpage_slot(struct process_info *pi, void *upage, bool create);
+static size_t evict_pages(size_t cnt, void **keep);
+static void wait_pageout(struct vpage_info *vpi);
+static void *get_user_page(bool zero);
+static bool vpage_info_unmap(struct vpage_info *vpi);
 static void vpage_info_lazy_to_inmem(struct vpage_info *vpi);
 static void vpage_info_swap_to_inmem(struct vpage_info *vpi);
-void vpage_info_release_inner(struct vpage_info *vpi);
-
-static int vpage_hash(struct hash_elem *e) {
-    struct vpage_info *vp = hash_entry(e, struct vpage_info, elem);
-    uint32_t v1 = (uint32_t)vp->uaddr;
-    uint32_t v2 = vp->pid;
-    return v1 * v2;
-};
-
-static bool vpage_less(struct hash_elem *e1, struct hash_elem *e2) {
-    struct vpage_info *vp1, *vp2;
-    vp1 = hash_entry(e1, struct vpage_info, elem);
-    vp2 = hash_entry(e2, struct vpage_info, elem);
-    if (vp1->uaddr == vp2->uaddr && vp1->pid == vp2->pid) {
-        return false;
+static bool vpage_info_insert(struct vpage_info *vpi, struct process_info *pi);
+static void vpage_info_destroy(struct vpage_info *vpi);
+void vpage_info_release_inner(struct vpage_info *vpi, struct process_info *pi);
+
+// returns the slot in PI's page table that holds the vpage_info for UPAGE.
+// if the table page covering UPAGE does not exist yet, it is created when
+// CREATE is true, otherwise NULL is returned. NULL is also returned if a page
+// could not be allocated.
+// synchronization must be guaranteed by the caller
+static struct vpage_info **vpage_slot(struct process_info *pi, void *upage, bool create) {
+    struct vpage_info **table;
+    ASSERT(is_user_vaddr(upage));
+    if (pi->vpages == NULL) {
+        if (!create || (pi->vpages = palloc_get_page(PAL_ZERO)) == NULL) {
+            return NULL;
+        }
     }
-    else {
-        return true;
+    table = pi->vpages->tables[pd_no(upage)];
+    if (table == NULL) {
+        if (!create || (table = palloc_get_page(PAL_ZERO)) == NULL) {
+            return NULL;
+        }
+        pi->vpages->tables[pd_no(upage)] = table;
     }
+    return &table[pt_no(upage)];
 }
 
+// adds VPI to PI's page table. fails if the page is already there.
 // synchronization must be guaranteed by the caller
-static void *evict_page() {
-    struct hash_iterator i;
-    struct vpage_info *lru_vpi = NULL;
-    void *paddr;
-    int swap_idx;
-    hash_first(&i, &vpage_info_map);
-    while(hash_next(&i)) {
-        struct vpage_info *vpi = hash_entry(hash_cur(&i), struct vpage_info, elem);
-        if (vpi->status == VPAGE_INMEM) {
-            if (lru_vpi) {
-                if (vpi->backend.inmem.last_use < lru_vpi->backend.inmem.last_use) {
-                    lru_vpi = vpi;
-                }
+static bool vpage_info_insert(struct vpage_info *vpi, struct process_info *pi) {
+    struct vpage_info **slot = vpage_slot(pi, vpi->uaddr, true);
+    if (slot == NULL || *slot != NULL) {
+        return false;
+    }
+    *slot = vpi;
+    return true;
+}
+
+// evicts up to CNT pages chosen by the frame table's clock. a page that is
+// clean and still backed by its file (or zeros) is just dropped, returning to
+// VPAGE_LAZY. a dirty mmap page is written back to its file and also returns
+// to VPAGE_LAZY. anything else is written to swap, all in one batch.
+// pages that need writing are unmapped and marked paging_out first, and
+// vm_lock is released during the writes, so that faults on other pages, in
+// this process or others, are not held up by the I/O. anyone else who needs a
+// paging_out page waits for it in wait_pageout().
+// if KEEP is not NULL, one frame is stored there instead of being freed.
+// returns the number of pages evicted.
+// vm_lock must be held.
+static size_t evict_pages(size_t cnt, void **keep) {
+    struct vpage_info *victims[EVICT_CLUSTER];
+    void *pages[EVICT_CLUSTER], *swap_pages[EVICT_CLUSTER];
+    size_t slots[EVICT_CLUSTER];
+    size_t n, i, write_cnt = 0, swap_cnt = 0;
+    ASSERT(cnt <= EVICT_CLUSTER);
+    for (n = 0; n < cnt; n++) {
+        struct vpage_info *vpi = frame_pick_victim();
+        if (vpi == NULL) {
+            break;
+        }
+        victims[n] = vpi;
+        pages[n] = vpi->backend.inmem.paddr;
+        if (!vpage_info_unmap(vpi) && vpi->backed) {
+            vpi->status = VPAGE_LAZY;
+            dropped_cnt++;
+            continue;
+        }
+        vpi->paging_out = true;
+        write_cnt++;
+        if (!vpi->writeback) {
+            swap_pages[swap_cnt++] = pages[n];
+        }
+    }
+    if (n == 0) {
+        return 0;
+    }
+
+    if (write_cnt > 0) {
+        pageout_cnt++;
+        lock_release(&vm_lock);
+        if (swap_cnt > 0) {
+            swap_out(swap_pages, swap_cnt, slots);
+        }
+        for (i = 0; i < n; i++) {
+            struct vpage_info *vpi = victims[i];
+            if (vpi->paging_out && vpi->writeback) {
+                file_write_at(vpi->lazy.file, pages[i], vpi->lazy.length, vpi->lazy.offset);
+            }
+        }
+        lock_acquire(&vm_lock);
+        pageout_cnt--;
+
+        swap_cnt = 0;
+        for (i = 0; i < n; i++) {
+            struct vpage_info *vpi = victims[i];
+            if (!vpi->paging_out) {
+                continue;
+            }
+            if (vpi->writeback) {
+                vpi->status = VPAGE_LAZY;
+                written_cnt++;
             }
             else {
-                lru_vpi = vpi;
+                vpi->backend.swap.swap_index = slots[swap_cnt++];
+                vpi->status = VPAGE_SWAPPED;
+                vpi->backed = false;
+                swapped_cnt++;
             }
+            vpi->paging_out = false;
         }
+        cond_broadcast(&pageout_done, &vm_lock);
     }
-    ASSERT(lru_vpi != NULL);
-    paddr = lru_vpi->backend.inmem.paddr;
-    vpage_info_inmem_to_swap(lru_vpi);
+
+    for (i = 0; i < n; i++) {
+        if (keep != NULL && i == 0) {
+            *keep = pages[i];
+        }
+        else {
+            palloc_free_page(pages[i]);
+        }
+    }
+    return n;
+}
+
+// waits until VPI is no longer being written out by evict_pages().
+// vm_lock must be held.
+static void wait_pageout(struct vpage_info *vpi) {
+    while (vpi->paging_out) {
+        cond_wait(&pageout_done, &vm_lock);
+    }
+}
+
+// returns a user page. when the pool is empty, evicts a batch of pages and
+// keeps one of their frames, or waits for a page-out in progress to free some.
+// the page-out daemon is woken once free frames run low, so that this rarely
+// has to evict by itself. may release vm_lock while waiting.
+// only ask for ZERO when the caller does not overwrite the whole page, so the
+// pre-zeroed pages palloc keeps go where they save work.
+// vm_lock must be held.
+static void *get_user_page(bool zero) {
+    void *paddr;
+    while ((paddr = palloc_get_page(PAL_USER | (zero ? PAL_ZERO : 0))) == NULL) {
+        if (evict_pages(EVICT_CLUSTER, &paddr) > 0) {
+            if (zero) {
+                memset(paddr, 0, PGSIZE);
+            }
+            break;
+        }
+        if (pageout_cnt == 0) {
+            PANIC("get_user_page: no user page can be evicted");
+        }
+        cond_wait(&pageout_done, &vm_lock);
+    }
+    pageout_check();
     return paddr;
 }
 
+// evicts up to CNT pages and frees their frames, for the page-out daemon.
+// returns the number of pages freed.
+size_t vpage_reclaim(size_t cnt) {
+    size_t done = 0, n;
+    lock_acquire(&vm_lock);
+    while (done < cnt) {
+        n = evict_pages(cnt - done < EVICT_CLUSTER ? cnt - done : EVICT_CLUSTER, NULL);
+        if (n == 0) {
+            break;
+        }
+        done += n;
+    }
+    lock_release(&vm_lock);
+    return done;
+}
+
+// takes VPI's page out of its process's page directory and the frame table,
+// so that its frame can be written out and reused, and returns whether the
+// page was written to while mapped. the caller must move VPI out of
+// VPAGE_INMEM.
 // synchronization must be guaranteed by the caller
-static void
-vpage_info_inmem_to_swap(struct vpage_info *vpi) {
+static bool
+vpage_info_unmap(struct vpage_info *vpi) {
     ASSERT(vpi->status == VPAGE_INMEM);
-    uint32_t swap_idx;
     pagedir_clear_page(vpi->backend.inmem.pagedir, vpi->uaddr);
-    swap_idx = swap_out(vpi->backend.inmem.paddr);
-    vpi->backend.swap.swap_index = swap_idx;
-    vpi->status = VPAGE_SWAPPED;
+    frame_set_owner(vpi->backend.inmem.paddr, NULL);
+    // the PTE keeps its dirty bit after being cleared, and no more writes can
+    // reach the page through it
+    return pagedir_is_dirty(vpi->backend.inmem.pagedir, vpi->uaddr);
 }
 
 // synchronization must be guaranteed by the caller
@@ -84,78 +228,82 @@ static void
 vpage_info_lazy_to_inmem(struct vpage_info *vpi) {
     ASSERT(vpi->status == VPAGE_LAZY);
     void *paddr;
-    if ((paddr = palloc_get_page(PAL_USER|PAL_ZERO)) == NULL) {
-        paddr = evict_page();
-    }
-    if (vpi->backend.lazy.file) {
-        file_read_at(vpi->backend.lazy.file, paddr, vpi->backend.lazy.length, vpi->backend.lazy.offset);
-        memset((char *)paddr + vpi->backend.lazy.length, 0, PGSIZE - vpi->backend.lazy.length);
-        file_close(vpi->backend.lazy.file);
+    if (vpi->lazy.file) {
+        paddr = get_user_page(false);
+        // the page is not pre-zeroed, so clear everything past what was read,
+        // including what a short read at the end of the file left behind
+        off_t read_bytes = file_read_at(vpi->lazy.file, paddr, vpi->lazy.length, vpi->lazy.offset);
+        memset((char *)paddr + read_bytes, 0, PGSIZE - read_bytes);
     }
     else {
-        memset(paddr, 0, PGSIZE);
+        paddr = get_user_page(true);
     }
     vpi->backend.inmem.paddr = paddr;
     vpi->backend.inmem.pagedir = thread_current()->pagedir;
-    vpi->backend.inmem.last_use = timer_ticks();
     vpi->status = VPAGE_INMEM;
+    frame_set_owner(paddr, vpi);
     pagedir_set_page(vpi->backend.inmem.pagedir, vpi->uaddr, paddr, vpi->writable);
 }
 
 static void
 vpage_info_swap_to_inmem(struct vpage_info *vpi) {
     ASSERT(vpi->status == VPAGE_SWAPPED);
-    void *paddr;
-    if ((paddr = palloc_get_page(PAL_USER|PAL_ZERO)) == NULL) {
-        paddr = evict_page();
-    }
+    void *paddr = get_user_page(false);
     swap_in(vpi->backend.swap.swap_index, paddr);
     vpi->backend.inmem.paddr = paddr;
     vpi->backend.inmem.pagedir = thread_current()->pagedir;
-    vpi->backend.inmem.last_use = timer_ticks();
     vpi->status = VPAGE_INMEM;
+    frame_set_owner(paddr, vpi);
     pagedir_set_page(vpi->backend.inmem.pagedir, vpi->uaddr, paddr, vpi->writable);
 }
 
+// frees VPI and whatever backs it, without touching the page table.
 // synchronization must be guaranteed by the caller
-void vpage_info_release_inner(struct vpage_info *vpi) {
+static void vpage_info_destroy(struct vpage_info *vpi) {
+    wait_pageout(vpi);
     switch (vpi->status) {
         case VPAGE_INMEM: {
-            pagedir_clear_page(vpi->backend.inmem.pagedir, vpi->uaddr);
+            // write dirty mmap pages back; evicted ones already were
+            if (vpage_info_unmap(vpi) && vpi->writeback) {
+                file_write_at(vpi->lazy.file, vpi->backend.inmem.paddr, vpi->lazy.length, vpi->lazy.offset);
+            }
             palloc_free_page(vpi->backend.inmem.paddr);
-            hash_delete(&vpage_info_map, &vpi->elem);
-            free(vpi);
             break;
         }
         case VPAGE_LAZY: {
-            if (vpi->backend.lazy.file != NULL) {
-                file_close(vpi->backend.lazy.file);
-                vpi->backend.lazy.file = NULL;
-            }
-            hash_delete(&vpage_info_map, &vpi->elem);
-            free(vpi);
             break;
         }
         case VPAGE_SWAPPED: {
             swap_free(vpi->backend.swap.swap_index);
-            hash_delete(&vpage_info_map, &vpi->elem);
-            free(vpi);
             break;
         }
         default: {
             NOT_REACHED();
         }
     }
+    if (vpi->lazy.file != NULL) {
+        file_close(vpi->lazy.file);
+    }
+    kmem_cache_free(&vpage_info_cache, vpi);
+}
+
+// synchronization must be guaranteed by the caller
+void vpage_info_release_inner(struct vpage_info *vpi, struct process_info *pi) {
+    struct vpage_info **slot = vpage_slot(pi, vpi->uaddr, false);
+    ASSERT(slot != NULL && *slot == vpi);
+    *slot = NULL;
+    vpage_info_destroy(vpi);
 }
 
 void vpage_init() {
-    hash_init(&vpage_info_map, vpage_hash, vpage_less, NULL);
     lock_init(&vm_lock);
+    cond_init(&pageout_done);
+    kmem_cache_init(&vpage_info_cache, "vpage_info", sizeof(struct vpage_info), 0, NULL);
 }
 
 struct vpage_info *
-vpage_info_lazy_allocate(void *uaddr, struct file *file, off_t offset, size_t length, pid_t pid, bool writable) {
-    struct vpage_info *new = malloc(sizeof(struct vpage_info)), *old;
+vpage_info_lazy_allocate(void *uaddr, struct file *file, off_t offset, size_t length, struct process_info *pi, bool writable, bool writeback) {
+    struct vpage_info *new = kmem_cache_alloc(&vpage_info_cache);
     struct file *file_copy;
 
     if (!new) {
@@ -165,6 +313,7 @@ vpage_info_lazy_allocate(void *uaddr, struct file *file, off_t offset, size_t le
     if (file != NULL) {
         file_copy = file_reopen(file);
         if (!file_copy) {
+            kmem_cache_free(&vpage_info_cache, new);
             return NULL;
         }
     }
@@ -174,50 +323,53 @@ vpage_info_lazy_allocate(void *uaddr, struct file *file, off_t offset, size_t le
     
     new->status = VPAGE_LAZY;
     new->uaddr = uaddr;
-    new->backend.lazy.file = file_copy;
-    new->backend.lazy.offset = offset;
-    new->backend.lazy.length = length;
-    new->pid = pid;
+    new->lazy.file = file_copy;
+    new->lazy.offset = offset;
+    new->lazy.length = length;
+    new->backed = true;
+    new->writeback = writeback;
     new->writable = writable;
+    new->paging_out = false;
     lock_acquire(&vm_lock);
-    if ((old = hash_find(&vpage_info_map, &new->elem)) != NULL) {
-        free(new);
+    if (!vpage_info_insert(new, pi)) {
+        if (file_copy != NULL) {
+            file_close(file_copy);
+        }
+        kmem_cache_free(&vpage_info_cache, new);
         new = NULL;
-        goto done;
     }
-    hash_insert(&vpage_info_map, &new->elem);
-done:
     lock_release(&vm_lock);
     return new;
 }
 
 // alloates paddr for you
 struct vpage_info *
-vpage_info_inmem_allocate(void *uaddr, void **paddr_, pid_t pid, bool writable) {
+vpage_info_inmem_allocate(void *uaddr, void **paddr_, struct process_info *pi, bool writable) {
     void *paddr;
-    struct vpage_info *new = malloc(sizeof(struct vpage_info)), *old;
+    struct vpage_info *new = kmem_cache_alloc(&vpage_info_cache);
     if (new == NULL) {
         return NULL;
     }
-    lock_acquire(&vm_lock);
-    if ((paddr = palloc_get_page(PAL_USER|PAL_ZERO)) == NULL) {
-        paddr = evict_page();
-    }
-    new->status = VPAGE_INMEM;
+    new->status = VPAGE_LAZY;
     new->uaddr = uaddr;
-    new->backend.inmem.paddr = paddr;
-    new->backend.inmem.pagedir = thread_current()->pagedir;
-    new->backend.inmem.last_use = timer_ticks();
-    new->pid = pid;
+    new->lazy.file = NULL;
+    new->lazy.offset = 0;
+    new->lazy.length = 0;
+    new->backed = true;
+    new->writeback = false;
     new->writable = writable;
-    
-    if ((old = hash_find(&vpage_info_map, &new->elem)) != NULL) {
-        NOT_REACHED();
-        free(new);
+    new->paging_out = false;
+    lock_acquire(&vm_lock);
+    if (!vpage_info_insert(new, pi)) {
+        kmem_cache_free(&vpage_info_cache, new);
         new = NULL;
         goto done;
     }
-    hash_insert(&vpage_info_map, &new->elem);
+    paddr = get_user_page(true);
+    new->status = VPAGE_INMEM;
+    new->backend.inmem.paddr = paddr;
+    new->backend.inmem.pagedir = thread_current()->pagedir;
+    frame_set_owner(paddr, new);
     pagedir_set_page(new->backend.inmem.pagedir, uaddr, paddr, writable);
     *paddr_ = paddr;
 done:
@@ -226,149 +378,127 @@ done:
 }
 
 struct vpage_info *
-vpage_info_swapped_allocate(void *uaddr, uint32_t swap_idx, pid_t pid, bool writable) {
-    struct vpage_info *new = malloc(sizeof(struct vpage_info)), *old;
+vpage_info_swapped_allocate(void *uaddr, uint32_t swap_idx, struct process_info *pi, bool writable) {
+    struct vpage_info *new = kmem_cache_alloc(&vpage_info_cache);
     if (new == NULL) {
         return NULL;
     }
     new->status = VPAGE_SWAPPED;
     new->uaddr = uaddr;
     new->backend.swap.swap_index = swap_idx;
-    new->pid = pid;
+    new->lazy.file = NULL;
+    new->backed = false;
+    new->writeback = false;
     new->writable = writable;
+    new->paging_out = false;
     lock_acquire(&vm_lock);
-    if ((old = hash_find(&vpage_info_map, &new->elem)) != NULL) {
-        free(new);
+    if (!vpage_info_insert(new, pi)) {
+        kmem_cache_free(&vpage_info_cache, new);
         new = NULL;
-        goto done;
     }
-    hash_insert(&vpage_info_map, &new->elem);
-done:
     lock_release(&vm_lock);
     return new;
 }
 
 void
-vpage_info_release(struct vpage_info *vpi) {
+vpage_info_release(struct vpage_info *vpi, struct process_info *pi) {
     lock_acquire(&vm_lock);
-    vpage_info_release_inner(vpi);
+    vpage_info_release_inner(vpi, pi);
     lock_release(&vm_lock);
 }
 
-void vpage_info_find_and_release(void *upage, pid_t pid) {
+void vpage_info_find_and_release(void *upage, struct process_info *pi) {
+    struct vpage_info **slot;
     lock_acquire(&vm_lock);
-    struct hash_iterator i;
-    hash_first(&i, &vpage_info_map);
-    while(hash_next(&i)) {
-        struct vpage_info *vpi = hash_entry(hash_cur(&i), struct vpage_info, elem);
-        if (vpi->uaddr == upage && vpi->pid == pid) {
-            vpage_info_release_inner(vpi);
-            goto done;
-        }
+    if ((slot = vpage_slot(pi, upage, false)) != NULL && *slot != NULL) {
+        vpage_info_destroy(*slot);
+        *slot = NULL;
     }
-done:
     lock_release(&vm_lock);
 }
 
-void vpage_info_set_writable(void *upage, pid_t pid, bool writable, bool *inmem) {
+// frees every page of PI and its page table, one table page at a time.
+void vpage_info_release_all(struct process_info *pi) {
+    size_t i, j;
     lock_acquire(&vm_lock);
-    struct hash_iterator i;
-    hash_first(&i, &vpage_info_map);
-    *inmem = false;
-    while(hash_next(&i)) {
-        struct vpage_info *vpi = hash_entry(hash_cur(&i), struct vpage_info, elem);
-        if (vpi->uaddr == upage && vpi->pid == pid) {
-            vpi->writable = writable;
-            if (vpi->status == VPAGE_INMEM) {
-                void *paddr = pagedir_get_page(vpi->backend.inmem.pagedir, upage);
-                ASSERT(paddr);
-                pagedir_clear_page(vpi->backend.inmem.pagedir, upage);
-                pagedir_set_page(vpi->backend.inmem.pagedir, upage, paddr, writable);
-                *inmem = true;
-            }
-            goto done;
-        }
+    if (pi->vpages == NULL) {
+        goto done;
     }
-done:
-    lock_release(&vm_lock);
-}
-
-void vpage_info_release_all(pid_t pid) {
-    lock_acquire(&vm_lock);
-    struct hash_iterator i;
-do_again:
-    hash_first(&i, &vpage_info_map);
-    while(hash_next(&i)) {
-        struct vpage_info *vpi = hash_entry(hash_cur(&i), struct vpage_info, elem);
-        if (vpi->pid == pid) {
-            vpage_info_release_inner(vpi);
-            goto do_again;
+    for (i = 0; i < pd_no(PHYS_BASE); i++) {
+        struct vpage_info **table = pi->vpages->tables[i];
+        if (table == NULL) {
+            continue;
         }
+        for (j = 0; j < PGSIZE / sizeof *table; j++) {
+            if (table[j] != NULL) {
+                vpage_info_destroy(table[j]);
+            }
+        }
+        palloc_free_page(table);
     }
+    palloc_free_page(pi->vpages);
+    pi->vpages = NULL;
 done:
     lock_release(&vm_lock);
 }
 
-struct vpage_info *vpage_info_find(void *upage, pid_t pid) {
-    struct vpage_info *rv;
+struct vpage_info *vpage_info_find(void *upage, struct process_info *pi) {
+    struct vpage_info **slot;
+    struct vpage_info *rv = NULL;
     lock_acquire(&vm_lock);
-    struct hash_iterator i;
-    hash_first(&i, &vpage_info_map);
-    while(hash_next(&i)) {
-        struct vpage_info *vpi = hash_entry(hash_cur(&i), struct vpage_info, elem);
-        if (vpi->uaddr == upage && vpi->pid == pid) {
-            rv = vpi;
-            goto done;
-        }
+    if ((slot = vpage_slot(pi, upage, false)) != NULL) {
+        rv = *slot;
     }
-rv = NULL;
-done:
     lock_release(&vm_lock);
     return rv;
 }
 
 // argument must be page aligned
 enum user_fault_type vpage_handle_user_fault(void *uaddr) {
-    enum user_fault_type res;
-    pid_t pid;
+    enum user_fault_type res = UFAULT_KILL;
+    struct process_info *pi = thread_current()->process_info;
+    struct vpage_info **slot;
     void *upage = pg_round_down(uaddr);
 
     // a thread faulted in user context even if it has no userspace... panic!
-    if (!thread_current()->process_info) {
+    if (!pi) {
         NOT_REACHED();
     }
-    pid = thread_current()->process_info->pid;
-    lock_acquire(&vm_lock);    
-
-    struct hash_iterator i;
-    hash_first(&i, &vpage_info_map);
-    while(hash_next(&i)) {
-        struct vpage_info *vpi = hash_entry(hash_cur(&i), struct vpage_info, elem);
-        if (vpi->uaddr == upage && vpi->pid == pid) {
-            switch (vpi->status) {
-                case VPAGE_INMEM: {
-                    res = UFAULT_KILL;
-                    goto done;
-                }
-                case VPAGE_LAZY: {
-                    vpage_info_lazy_to_inmem(vpi);
-                    res = UFAULT_CONTINUE;
-                    goto done;
-                }
-                case VPAGE_SWAPPED: {
-                    vpage_info_swap_to_inmem(vpi);
-                    res = UFAULT_CONTINUE;
-                    goto done;
-                }
-                default: {
-                    NOT_REACHED();
-                }
-            }
+    // not present: kill
+    if (!is_user_vaddr(upage)) {
+        return UFAULT_KILL;
+    }
+    lock_acquire(&vm_lock);
+    if ((slot = vpage_slot(pi, upage, false)) == NULL || *slot == NULL) {
+        goto done;
+    }
+    wait_pageout(*slot);
+    switch ((*slot)->status) {
+        case VPAGE_INMEM: {
+            res = UFAULT_KILL;
+            break;
+        }
+        case VPAGE_LAZY: {
+            vpage_info_lazy_to_inmem(*slot);
+            res = UFAULT_CONTINUE;
+            break;
+        }
+        case VPAGE_SWAPPED: {
+            vpage_info_swap_to_inmem(*slot);
+            res = UFAULT_CONTINUE;
+            break;
+        }
+        default: {
+            NOT_REACHED();
         }
     }
-// not present: kill
-res = UFAULT_KILL;
 done:
     lock_release(&vm_lock);
     return res;
-}
\ No newline at end of file
+}
+
+// prints how evicted pages left memory.
+void vpage_print_stats(void) {
+    printf("Eviction: %llu clean pages dropped, %llu written back to files, "
+           "%llu swapped out\n", dropped_cnt, written_cnt, swapped_cnt);
+}
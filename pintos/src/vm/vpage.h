@@ -1,6 +1,6 @@
 #include <list.h>
-#include <hash.h>
 #include <stdio.h>
+#include "threads/pte.h"
 #include "userprog/process.h"
 #include "userprog/pagedir.h"
 #include "filesys/off_t.h"
@@ -25,7 +25,6 @@ struct info_lazy {
 struct info_inmem {
     void *paddr;
     uint32_t *pagedir;
-    int64_t last_use;
 };
 
 struct info_swap {
@@ -33,7 +32,6 @@ struct info_swap {
 };
 
 union vpage_info_backend {
-    struct info_lazy lazy;
     struct info_inmem inmem;
     struct info_swap swap;
 };
@@ -42,16 +40,33 @@ struct vpage_info {
     enum vpage_status status;
     void *uaddr;
     bool writable;
-    pid_t pid;
+    bool paging_out;            // unmapped and being written out, see evict_pages()
+    // where a VPAGE_LAZY page is loaded from: LENGTH bytes of FILE, zeros
+    // after them (or everywhere if FILE is NULL). kept while the page is in
+    // memory, so that a page that is still clean can be dropped on eviction
+    // instead of being written to swap. BACKED is false once the contents
+    // went to swap instead, since the file or zeros are out of date then.
+    struct info_lazy lazy;
+    bool backed;
+    bool writeback;             // dirty contents go back to FILE, not to swap (mmap)
     union vpage_info_backend backend;
-    struct hash_elem elem;
 };
 
-struct vpage_info *vpage_info_lazy_allocate(void *uaddr, struct file *file, off_t offset, size_t length, pid_t pid, bool writable);
-struct vpage_info *vpage_info_inmem_allocate(void *uaddr, void **paddr_, pid_t pid, bool writable);
-struct vpage_info *vpage_info_swapped_allocate(void *uaddr, uint32_t swap_idx, pid_t pid, bool writable);
-void vpage_info_release(struct vpage_info *vpi);
-void vpage_info_find_and_release(void *upage, pid_t pid);
-void vpage_info_set_writable(void *upage, pid_t pid, bool writable, bool *inmem);
-struct vpage_info *vpage_info_find(void *upage, pid_t pid);
-enum user_fault_type vpage_handle_user_fault(void *uaddr);
\ No newline at end of file
+// per-process supplemental page table, hung off process_info and split like
+// the x86 page directory: a directory page of pointers to table pages, each
+// holding the vpage_info pointers for 4 MB of user address space.
+// table pages are allocated on first use.
+struct vpage_table {
+    struct vpage_info **tables[1 << PDBITS];
+};
+
+struct vpage_info *vpage_info_lazy_allocate(void *uaddr, struct file *file, off_t offset, size_t length, struct process_info *pi, bool writable, bool writeback);
+struct vpage_info *vpage_info_inmem_allocate(void *uaddr, void **paddr_, struct process_info *pi, bool writable);
+struct vpage_info *vpage_info_swapped_allocate(void *uaddr, uint32_t swap_idx, struct process_info *pi, bool writable);
+void vpage_info_release(struct vpage_info *vpi, struct process_info *pi);
+void vpage_info_find_and_release(void *upage, struct process_info *pi);
+void vpage_info_release_all(struct process_info *pi);
+struct vpage_info *vpage_info_find(void *upage, struct process_info *pi);
+enum user_fault_type vpage_handle_user_fault(void *uaddr);
+size_t vpage_reclaim(size_t cnt);
+void vpage_print_stats(void);